@@ -0,0 +1,40 @@
+#ifndef FRAMESOURCE_HPP__
+#define FRAMESOURCE_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+class FrameSource
+{
+public:
+
+  enum Pacing
+  {
+    PACING_REALTIME,
+    PACING_AS_FAST_AS_POSSIBLE
+  };
+
+  FrameSource(Pacing pacing);
+  virtual ~FrameSource();
+
+  virtual bool isOpened() const = 0;
+  virtual bool read(cv::Mat& frame) = 0;
+  // also reports when the frame was captured, in cv::getTickCount() ticks
+  virtual bool readTimestamped(cv::Mat& frame, int64& captureTicks);
+
+  virtual bool isLive() const = 0;
+  virtual std::string description() const = 0;
+
+  virtual size_t droppedFrames() const;
+
+  Pacing getPacing() const;
+  void setPacing(Pacing pacing);
+
+  static FrameSource* open(const std::string& location, Pacing pacing);
+
+private:
+  Pacing _pacing;
+};
+
+#endif // FRAMESOURCE_HPP
@@ -0,0 +1,29 @@
+#ifndef IMAGEDIRFRAMESOURCE_HPP__
+#define IMAGEDIRFRAMESOURCE_HPP__
+
+#include "framesource.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+class ImageDirFrameSource : public FrameSource
+{
+public:
+  ImageDirFrameSource(const std::string& directory, Pacing pacing = PACING_AS_FAST_AS_POSSIBLE);
+  virtual ~ImageDirFrameSource();
+
+  virtual bool isOpened() const;
+  virtual bool read(cv::Mat& frame);
+
+  virtual bool isLive() const;
+  virtual std::string description() const;
+
+private:
+  std::string _directory;
+  std::vector<std::string> _files;
+  size_t _position;
+};
+
+#endif // IMAGEDIRFRAMESOURCE_HPP
@@ -0,0 +1,48 @@
+#ifndef LATESTFRAMESOURCE_HPP__
+#define LATESTFRAMESOURCE_HPP__
+
+#include "framesource.hpp"
+#include "../utils/latestslot.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Drains a live source on its own thread so that read() always returns the
+// newest frame instead of one that waited in the device buffer.
+class LatestFrameSource : public FrameSource
+{
+public:
+  // takes ownership of the source
+  LatestFrameSource(FrameSource *source);
+  virtual ~LatestFrameSource();
+
+  virtual bool isOpened() const;
+  virtual bool read(cv::Mat& frame);
+  virtual bool readTimestamped(cv::Mat& frame, int64& captureTicks);
+
+  virtual bool isLive() const;
+  virtual std::string description() const;
+
+  virtual size_t droppedFrames() const;
+
+private:
+  struct CapturedFrame
+  {
+    cv::Mat frame;
+    int64 captureTicks;
+  };
+
+  FrameSource *_source;
+
+  LatestSlot<CapturedFrame> _latest;
+  std::atomic<bool> _running;
+  std::atomic<bool> _ended;
+  std::thread _captureThread;
+
+  void capture();
+};
+
+#endif // LATESTFRAMESOURCE_HPP
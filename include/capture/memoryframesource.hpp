@@ -0,0 +1,30 @@
+#ifndef MEMORYFRAMESOURCE_HPP__
+#define MEMORYFRAMESOURCE_HPP__
+
+#include "framesource.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+class MemoryFrameSource : public FrameSource
+{
+public:
+  MemoryFrameSource(const std::vector<cv::Mat>& frames, Pacing pacing = PACING_AS_FAST_AS_POSSIBLE);
+  virtual ~MemoryFrameSource();
+
+  virtual bool isOpened() const;
+  virtual bool read(cv::Mat& frame);
+
+  virtual bool isLive() const;
+  virtual std::string description() const;
+
+  void rewind();
+
+private:
+  std::vector<cv::Mat> _frames;
+  size_t _position;
+};
+
+#endif // MEMORYFRAMESOURCE_HPP
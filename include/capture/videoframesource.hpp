@@ -0,0 +1,31 @@
+#ifndef VIDEOFRAMESOURCE_HPP__
+#define VIDEOFRAMESOURCE_HPP__
+
+#include "framesource.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <string>
+
+class VideoFrameSource : public FrameSource
+{
+public:
+  VideoFrameSource(int camera, Pacing pacing = PACING_REALTIME);
+  VideoFrameSource(const std::string& filename, Pacing pacing = PACING_AS_FAST_AS_POSSIBLE);
+  virtual ~VideoFrameSource();
+
+  virtual bool isOpened() const;
+  virtual bool read(cv::Mat& frame);
+
+  virtual bool isLive() const;
+  virtual std::string description() const;
+
+private:
+  cv::VideoCapture _videoCapture;
+
+  bool _live;
+  std::string _description;
+};
+
+#endif // VIDEOFRAMESOURCE_HPP
@@ -0,0 +1,114 @@
+#ifndef BINARYMODEL_HPP__
+#define BINARYMODEL_HPP__
+
+#include "../utils/mappedfile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define BINARY_MODEL_VERSION 3
+#define BINARY_MODEL_EXTENSION ".bin"
+// sections start at multiples of this, so mapped data can be used in place
+#define BINARY_MODEL_ALIGNMENT 32
+
+// Binary classifier model file: a header followed by the sections it lists.
+// Numbers are stored in the byte order of the machine that wrote the file.
+// Files of version 1 lack the features and are read as pixel models, files
+// of version 1 and 2 lack the sigmoids of the SVM decisions.
+struct BinaryModelHeader
+{
+  enum Type
+  {
+    TYPE_RBF_SVM = 1
+  };
+
+  enum Section
+  {
+    SECTION_PCA_MEAN,
+    SECTION_PCA_EIGENVECTORS,
+    SECTION_CLASS_LABELS,
+    SECTION_DECISIONS,
+    SECTION_SV_INDICES,
+    SECTION_ALPHAS,
+    SECTION_SQUARED_NORMS,
+    SECTION_SUPPORT_VECTORS,
+    SECTION_SIGMOIDS,
+    SECTION_COUNT
+  };
+
+  BinaryModelHeader();
+
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  uint32_t type;
+
+  // preprocessing
+  uint32_t sampleWidth;
+  uint32_t features;
+  uint32_t pcaComponents;
+
+  // RBF SVM
+  uint32_t varCount;
+  uint32_t stride;
+  uint32_t svCount;
+  uint32_t classCount;
+  uint32_t coefficientCount;
+  float gamma;
+
+  uint64_t offsets[SECTION_COUNT];
+  uint64_t sizes[SECTION_COUNT];
+};
+
+class BinaryModelWriter
+{
+public:
+  BinaryModelWriter();
+
+  BinaryModelHeader& header();
+  void setSection(BinaryModelHeader::Section section, const void* data, size_t size);
+
+  bool write(const std::string& filename) const;
+
+  // models are saved in the binary format if the filename ends with BINARY_MODEL_EXTENSION
+  static bool isBinaryFilename(const std::string& filename);
+
+private:
+  BinaryModelHeader _header;
+  std::vector<char> _sections[BinaryModelHeader::SECTION_COUNT];
+};
+
+class BinaryModelReader
+{
+public:
+  BinaryModelReader();
+
+  // maps the file and checks its header and section bounds, older versions
+  // are converted to the current header
+  bool open(const std::string& filename);
+
+  const BinaryModelHeader& header() const;
+
+  // nullptr unless the section holds exactly count elements of T
+  template<typename T>
+  const T* section(BinaryModelHeader::Section section, size_t count) const
+  {
+    if (_header.sizes[section] != count * sizeof(T))
+      return nullptr;
+
+    return count == 0 ? nullptr : reinterpret_cast<const T*>(_file->data() + _header.offsets[section]);
+  }
+
+  // keeps the mapping alive as long as the data is used
+  std::shared_ptr<const MappedFile> file() const;
+
+  static bool isBinaryModel(const std::string& filename);
+
+private:
+  std::shared_ptr<MappedFile> _file;
+  BinaryModelHeader _header;
+};
+
+#endif // BINARYMODEL_HPP
@@ -0,0 +1,57 @@
+#ifndef CASCADEDIGITCLASSIFIER_HPP__
+#define CASCADEDIGITCLASSIFIER_HPP__
+
+#include "digitclassifier.hpp"
+#include "nndigitclassifier.hpp"
+#include "svmdigitclassifier.hpp"
+#include "../imgproc/digitextractor.hpp"
+
+#include <atomic>
+#include <string>
+
+// Classifies every digit with the int8 MLP and only the digits it gives a
+// confidence below minConfidence again with the RBF SVM.
+class CascadeDigitClassifier : public DigitClassifier
+{
+public:
+  CascadeDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents = 0,
+                         float minConfidence = CASCADE_MIN_CONFIDENCE);
+  virtual ~CascadeDigitClassifier();
+
+  virtual void train(const std::vector<cv::Mat> *trainingImages);
+
+  // the SVM is stored in filename, the MLP next to it in fastStageFilename(filename)
+  virtual bool load(const std::string& filename);
+  virtual bool save(const std::string& filename) const;
+  static std::string fastStageFilename(const std::string& filename);
+
+  virtual void setFeatures(DigitFeatures::Type features);
+
+  size_t classifiedCount() const;
+  size_t escalatedCount() const;
+  // fraction of the classified digits the SVM classified again
+  double escalationRate() const;
+
+protected:
+  virtual void predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const;
+
+private:
+  // both stages get the samples prepared once, so their preprocessing has to match
+  struct CascadeModel : public Model
+  {
+    std::shared_ptr<const Model> fast;
+    std::shared_ptr<const Model> accurate;
+  };
+
+  bool publishStages();
+  static bool samePreprocessing(const Model& a, const Model& b);
+
+  NNDigitClassifier _fast;
+  SVMDigitClassifier _accurate;
+  float _minConfidence;
+
+  mutable std::atomic<size_t> _classified;
+  mutable std::atomic<size_t> _escalated;
+};
+
+#endif // CASCADEDIGITCLASSIFIER_HPP
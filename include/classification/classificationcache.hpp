@@ -0,0 +1,46 @@
+#ifndef CLASSIFICATIONCACHE_HPP__
+#define CLASSIFICATIONCACHE_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+
+#include "digitclassifier.hpp"
+#include "../settings.hpp"
+
+// Remembers the last classification of every cell together with a binary
+// signature of its digit, so a cell that looks the same as before is not
+// classified again.
+class ClassificationCache
+{
+public:
+  ClassificationCache();
+
+  void clear();
+
+  // 8x8 binary image of the digit as it is scaled to the sample size
+  static uint64 signature(const cv::Mat& digit);
+
+  bool lookup(size_t row, size_t col, uint64 signature, size_t modelGeneration, Classification& classification);
+  void store(size_t row, size_t col, uint64 signature, size_t modelGeneration, const Classification& classification);
+
+  size_t lookups() const;
+  size_t hits() const;
+  double hitRate() const;
+
+private:
+  struct Entry
+  {
+    bool valid;
+    uint64 signature;
+    size_t modelGeneration;
+    Classification classification;
+  };
+
+  Entry _entries[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+
+  std::atomic<size_t> _lookups;
+  std::atomic<size_t> _hits;
+};
+
+#endif // CLASSIFICATIONCACHE_HPP
@@ -0,0 +1,29 @@
+#ifndef CLASSIFIERBACKEND_HPP__
+#define CLASSIFIERBACKEND_HPP__
+
+#include "digitclassifier.hpp"
+#include "../imgproc/digitextractor.hpp"
+
+#include <string>
+
+// The classifiers the pipeline can recognize digits with.
+class ClassifierBackend
+{
+public:
+  enum Type
+  {
+    BACKEND_KNN,
+    BACKEND_SVM,
+    BACKEND_NN,
+    // the MLP for every cell, the SVM for the cells the MLP is unsure about
+    BACKEND_CASCADE
+  };
+
+  // an untrained classifier with the configured sample width and PCA components
+  static DigitClassifier* create(Type type, const DigitExtractor& extractor);
+
+  static std::string name(Type type);
+  static bool parse(const std::string& name, Type& type);
+};
+
+#endif // CLASSIFIERBACKEND_HPP
@@ -3,9 +3,28 @@
 
 #include <opencv2/core/core.hpp>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "../imgproc/digitextractor.hpp"
+#include "../settings.hpp"
+#include "binarymodel.hpp"
+#include "digitfeatures.hpp"
+
+struct Classification
+{
+  Classification();
+
+  uchar label;
+  // probability of the label, the share of scores it received
+  float confidence;
+  // probability of each digit from 1 to NUM_DIGITS, summing up to 1
+  float scores[NUM_DIGITS];
+
+  // normalizes the scores and takes the confidence of the given label
+  void finish(uchar label);
+};
 
 class DigitClassifier
 {
@@ -14,31 +33,96 @@ public:
   DigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents = 0);
   virtual ~DigitClassifier();
 
+  // training and loading publish a new model, classification never waits for them
   virtual void train(const std::vector<cv::Mat>* trainingImages) = 0;
-  virtual uchar classify(const cv::Mat& image) = 0;
+
+  bool hasModel() const;
+  size_t modelGeneration() const;
+
+  // Classification keeps its buffers in thread_local storage between calls, so it
+  // allocates nothing once they have grown. Each call still copies the shared_ptr of
+  // the current model, which keeps the model alive while the next one is published.
+  uchar classify(const cv::Mat& image) const;
+  void classify(const cv::Mat& image, Classification& classification) const;
+  // classifies all images with one prediction
+  void classifyBatch(const std::vector<cv::Mat>& images, std::vector<Classification>& classifications) const;
+  // like classifyBatch, but uses the digits the extractor already extracted from the given cells
+  void classifyCells(const std::vector<cv::Point>& cells, std::vector<Classification>& classifications) const;
+  // classifies digits already extracted and cropped to their bounding box
+  void classifyDigits(const std::vector<cv::Mat>& digits, std::vector<Classification>& classifications) const;
 
   virtual bool save(const std::string& filename) const = 0;
   virtual bool load(const std::string& filename) = 0;
 
+  // features of the models trained from now on
+  virtual void setFeatures(DigitFeatures::Type features);
+
+  // preprocessing of the current model, or of the next one trained if there is none
+  DigitFeatures::Type getFeatures() const;
   size_t getSampleWidth() const;
 
   bool usePCA() const;
   size_t getPCAComponents() const;
 
 protected:
-  cv::Mat prepareDigitMat(const cv::Mat& in, bool pca = true) const;
-  void prepareTrainingMat(const std::vector<cv::Mat>* trainingImages, cv::Mat& trainingMat, cv::Mat& labelMat);
+  // The trained state. A published model is never modified, so any number of
+  // threads can classify with it while the next one is trained.
+  struct Model
+  {
+    Model();
+    virtual ~Model();
+
+    size_t generation;
+    // digits are scaled to sampleWidth x sampleWidth, turned into features
+    // and projected with pca, if any
+    size_t sampleWidth;
+    DigitFeatures::Type features;
+    std::shared_ptr<const cv::PCA> pca;
+    // mapped model file the model data may point into
+    std::shared_ptr<const MappedFile> file;
+  };
+
+  // one sample per row, must be safe to call from several threads
+  virtual void predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const = 0;
+
+  std::shared_ptr<const Model> model() const;
+  void setModel(const std::shared_ptr<Model>& model);
+
+  // let classifiers combining other classifiers use their models
+  static std::shared_ptr<const Model> modelOf(const DigitClassifier& classifier);
+  static void predictWith(const DigitClassifier& classifier, const Model& model, const cv::Mat& samples,
+                          std::vector<Classification>& classifications);
+
+  cv::Mat prepareDigitMat(const cv::Mat& in, const Model& model) const;
+  cv::Mat prepareDigitBatch(const std::vector<cv::Mat>& images, const Model& model) const;
+  void prepareTrainingMat(const std::vector<cv::Mat>* trainingImages, cv::Mat& trainingMat, cv::Mat& labelMat, Model& model) const;
+
+  // sample width and PCA basis, saved together with the classifier
+  void writePreprocessing(cv::FileStorage& fs, const Model& model) const;
+  bool readPreprocessing(const cv::FileStorage& fs, Model& model) const;
+  void writePreprocessing(const Model& model, BinaryModelWriter& writer) const;
+  bool readPreprocessing(const BinaryModelReader& reader, Model& model) const;
+  // number of features of a sample, before PCA
+  size_t featureSize(const Model& model) const;
+  // number of values per sample the classifier of the model gets
+  size_t inputSize(const Model& model) const;
 
 private:
   const DigitExtractor &_extractor;
 
-  template<typename T>
-  cv::Mat toRowVector(const cv::Mat& in) const;
+  void classifyDigits(const Model& model, const std::vector<cv::Mat>& digits,
+                      std::vector<Classification>& classifications) const;
 
-  size_t _sampleWidth;
+  cv::Mat prepareSample(const cv::Mat& in, const Model& model) const;
+  void prepareExtractedDigit(const cv::Mat& digit, const Model& model, cv::Mat& sample) const;
+  cv::Mat projectSamples(const cv::Mat& samples, const Model& model) const;
 
+  size_t _sampleWidth;
   size_t _pcaComponents;
-  cv::PCA *_pca;
+  DigitFeatures::Type _features;
+
+  std::shared_ptr<const Model> _model;
+  std::atomic<size_t> _generation;
 };
 
 #endif // DIGITCLASSIFIER_HPP
@@ -0,0 +1,31 @@
+#ifndef DIGITFEATURES_HPP__
+#define DIGITFEATURES_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+// The values a classifier sees of a digit scaled to sampleWidth x sampleWidth.
+class DigitFeatures
+{
+public:
+  enum Type
+  {
+    // the pixels scaled to [0, 1]
+    FEATURES_PIXELS,
+    // histograms of oriented gradients over HOG_CELLS x HOG_CELLS cells
+    FEATURES_HOG
+  };
+
+  static size_t size(Type type, size_t sampleWidth);
+  // size of the digit image compute() takes without scaling it first
+  static cv::Size sampleSize(Type type, size_t sampleWidth);
+
+  // digit is the 8 bit image of the cropped digit, features a row of size() floats
+  static void compute(Type type, size_t sampleWidth, const cv::Mat& digit, cv::Mat& features);
+
+  static std::string name(Type type);
+  static bool parse(const std::string& name, Type& type);
+};
+
+#endif // DIGITFEATURES_HPP
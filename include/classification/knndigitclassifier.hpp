@@ -5,28 +5,54 @@
 #include "../imgproc/digitextractor.hpp"
 
 #include <opencv2/opencv.hpp>
-#include <opencv2/ml/ml.hpp>
+#include <opencv2/flann/flann.hpp>
 
+#include <memory>
 #include <vector>
 
 class KNNDigitClassifier : public DigitClassifier
 {
 public:
-  KNNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t k, size_t pcaComponents = 0);
+  enum Search
+  {
+    // KD-tree for large training sets of few dimensions, brute force otherwise
+    SEARCH_AUTO,
+    SEARCH_BRUTE_FORCE,
+    SEARCH_KD_TREE
+  };
+
+  KNNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t k, size_t pcaComponents = 0, Search search = SEARCH_AUTO);
   virtual ~KNNDigitClassifier();
 
   virtual void train(const std::vector<cv::Mat>* trainingImages);
-  virtual uchar classify(const cv::Mat& image);
 
   virtual bool load(const std::string& filename);
   virtual bool save(const std::string& filename) const;
 
+  // whether the current model searches a KD-tree
+  bool usesKDTree() const;
+
+protected:
+  virtual void predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const;
+
 private:
-  cv::KNearest *_knn;
-  size_t _k;
+  struct KNNModel : public Model
+  {
+    KNNModel();
+
+    // the training data, which the index refers to and the model files hold
+    cv::Mat samples;
+    cv::Mat responses;
 
-  void create();
-  void cleanup();
+    // only searched after it is built, which is safe from several threads
+    std::shared_ptr<cv::flann::Index> index;
+    bool kdTree;
+  };
+
+  void buildIndex(KNNModel& model) const;
+
+  size_t _k;
+  Search _search;
 };
 
 #endif // KNNDIGITCLASSIFIER_HPP
@@ -2,24 +2,59 @@
 #define NNDIGITCLASSIFIER_HPP__
 
 #include "digitclassifier.hpp"
+#include "quantizedmlp.hpp"
 #include "../imgproc/digitextractor.hpp"
 
 #include <opencv2/ml/ml.hpp>
 
+#include <atomic>
+
 class NNDigitClassifier : public DigitClassifier
 {
 public:
-  NNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents = 0);
+  NNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents = 0, bool quantized = NN_QUANTIZED);
   virtual ~NNDigitClassifier();
 
   virtual void train(const std::vector<cv::Mat> *trainingImages);
-  virtual uchar classify(const cv::Mat& image);
 
   virtual bool load(const std::string& filename);
   virtual bool save(const std::string& filename) const;
 
+  // classify with the int8 weights instead of the trained MLP
+  void setQuantized(bool quantized);
+  bool isQuantized() const;
+
+protected:
+  virtual void predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const;
+
 private:
-  CvANN_MLP *_nn;
+  // gives access to the weights and activation function of CvANN_MLP
+  class ExportableMLP : public CvANN_MLP
+  {
+  public:
+    bool exportTo(QuantizedMLP& mlp) const;
+  };
+
+  struct NNModel : public Model
+  {
+    NNModel() : temperature(0.f)
+    {
+    }
+
+    ExportableMLP nn;
+    // empty unless the MLP uses the symmetric sigmoid
+    QuantizedMLP quantized;
+    // softmax temperature of the outputs, 0 for models saved without it
+    float temperature;
+  };
+
+  std::atomic<bool> _quantized;
+
+  // the outputs the MLP is trained towards, 1 for the digit and 0 for the others
+  static cv::Mat targets(const cv::Mat& labelMat);
+  // fits the temperature on outputs of MLPs that were not trained on the samples,
+  // so the confidence the cascade compares is a probability like that of the SVM
+  void calibrate(const cv::Mat& trainingMat, const cv::Mat& labelMat, const cv::Mat& layers, NNModel& model) const;
 };
 
 #endif // NNDIGITCLASSIFIER_HPP
@@ -0,0 +1,68 @@
+#ifndef QUANTIZEDMLP_HPP__
+#define QUANTIZEDMLP_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "digitclassifier.hpp"
+
+// Inference for a multilayer perceptron with symmetric sigmoid activation and
+// int8 weights. Each neuron stores its weights scaled by its own factor; the
+// inputs are scaled in float first and the activations are quantized per layer
+// and sample, so every neuron is a single int8 dot product.
+class QuantizedMLP
+{
+public:
+  QuantizedMLP();
+
+  void clear();
+  bool empty() const;
+
+  // activation beta * (1 - exp(-alpha * x)) / (1 + exp(-alpha * x))
+  void setActivation(double alpha, double beta);
+  // applied to the inputs before the first layer: y = scale * x + shift
+  void setInputScale(const std::vector<float>& scale, const std::vector<float>& shift);
+  // row j of weights holds the weights of output j
+  void addLayer(const cv::Mat& weights, const std::vector<float>& bias);
+  // applied to the outputs of the last layer: y = scale * x + shift
+  void setOutputScale(const std::vector<float>& scale, const std::vector<float>& shift);
+  // softmax temperature of the scores, see classify()
+  void setTemperature(float temperature);
+
+  // one sample per row, may be called from several threads
+  void predict(const cv::Mat& samples, std::vector<Classification>& classifications) const;
+
+  size_t inputs() const;
+
+  // scores of outputs trained towards 1 for the digit and 0 for the others, a
+  // softmax at the given temperature or, for 0, the outputs clipped at 0
+  static void classify(const float *outputs, size_t count, float temperature, Classification& classification);
+
+private:
+  struct Layer
+  {
+    size_t inputs;
+    size_t outputs;
+    // row length of weights, a multiple of 16
+    size_t stride;
+    // one step of the int8 weights of each output
+    std::vector<float> scales;
+    std::vector<int8_t> weights;
+    std::vector<float> bias;
+  };
+
+  void forward(const float* sample, std::vector<float>& outputs) const;
+
+  std::vector<Layer> _layers;
+  float _alpha;
+  float _beta;
+  std::vector<float> _inputScale;
+  std::vector<float> _inputShift;
+  std::vector<float> _outputScale;
+  std::vector<float> _outputShift;
+  float _temperature;
+};
+
+#endif // QUANTIZEDMLP_HPP
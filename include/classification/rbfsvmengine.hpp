@@ -0,0 +1,110 @@
+#ifndef RBFSVMENGINE_HPP__
+#define RBFSVMENGINE_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "digitclassifier.hpp"
+#include "binarymodel.hpp"
+#include "../settings.hpp"
+
+// Inference for a trained one-versus-one C-SVM with RBF kernel. The support
+// vectors are kept in one aligned matrix, the kernel values of a sample are
+// computed once for all decision functions and SVM_BATCH_SIZE samples share
+// each pass over the support vectors.
+//
+// The label is the winner of the pairwise votes, like CvSVM::predict. The
+// scores are class probabilities: a sigmoid of each decision value estimates
+// the probability of one class against the other (Platt scaling) and the
+// pairwise probabilities are coupled into one distribution with the second
+// method of Wu, Lin and Weng, as libsvm does.
+class RBFSVMEngine
+{
+public:
+  // probability of the first class of a decision: 1 / (1 + exp(a * value + b))
+  struct Sigmoid
+  {
+    double a;
+    double b;
+  };
+
+  RBFSVMEngine();
+
+  void clear();
+  bool empty() const;
+  size_t supportVectorCount() const;
+  size_t decisionCount() const;
+
+  void setSupportVectors(const float* const* supportVectors, int count, int varCount, double gamma);
+  void addClass(int label);
+  // decisions have to be added in the order CvSVM stores them: (0,1), (0,2), ..., (1,2), ...
+  // the decision gets the sigmoid a = -SVM_DECISION_SLOPE, b = 0 until calibrated
+  void addDecision(double rho, const int* svIndex, const double* alpha, int count);
+
+  // fits the sigmoids to decision values of samples the SVM was not trained on,
+  // one row per sample and one column per decision, and their labels
+  void calibrate(const cv::Mat& values, const cv::Mat& labels);
+  std::vector<Sigmoid> sigmoids() const;
+  bool setSigmoids(const std::vector<Sigmoid>& sigmoids);
+
+  void write(BinaryModelWriter& writer) const;
+  // uses the arrays of the mapped file in place
+  bool read(const BinaryModelReader& reader);
+
+  // one sample per row, may be called from several threads
+  void predict(const cv::Mat& samples, std::vector<Classification>& classifications) const;
+  // one row of CV_64FC1 decision values per sample, in the order of the decisions
+  void decisionValues(const cv::Mat& samples, cv::Mat& values) const;
+
+private:
+  RBFSVMEngine(const RBFSVMEngine&) = delete;
+  RBFSVMEngine& operator=(const RBFSVMEngine&) = delete;
+
+  // stored as is in binary model files
+  struct Decision
+  {
+    double rho;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // kernels receives count rows of _count kernel values
+  void computeKernels(const cv::Mat& samples, int first, int count, float* kernels) const;
+  void decide(const float* kernel, double* values) const;
+  void score(const double* values, Classification& classification) const;
+
+  size_t _count;
+  size_t _varCount;
+  // row length of the support vectors, a multiple of 8 floats
+  size_t _stride;
+  float _gamma;
+
+  size_t _classCount;
+  size_t _coefficientCount;
+
+  // point either into the vectors below or into a mapped model file
+  const float *_supportVectors;
+  const float *_squaredNorms;
+  const int32_t *_labels;
+  const Decision *_decisions;
+  const int32_t *_svIndices;
+  const double *_alphas;
+  const Sigmoid *_sigmoids;
+
+  std::vector<float> _supportVectorStorage;
+  std::vector<float> _squaredNormStorage;
+  std::vector<int32_t> _labelStorage;
+  std::vector<Decision> _decisionStorage;
+  std::vector<int32_t> _svIndexStorage;
+  std::vector<double> _alphaStorage;
+  std::vector<Sigmoid> _sigmoidStorage;
+
+  std::shared_ptr<const MappedFile> _file;
+
+  void useStorage();
+};
+
+#endif // RBFSVMENGINE_HPP
@@ -2,6 +2,7 @@
 #define SVMDIGITCLASSIFIER_HPP__
 
 #include "digitclassifier.hpp"
+#include "rbfsvmengine.hpp"
 #include "../imgproc/digitextractor.hpp"
 
 #include <opencv2/core/core.hpp>
@@ -16,16 +17,40 @@ public:
   virtual ~SVMDigitClassifier();
 
   virtual void train(const std::vector<cv::Mat> *trainingImages);
-  virtual uchar classify(const cv::Mat& image);
 
   virtual bool save(const std::string& filename) const;
   virtual bool load(const std::string& filename);
 
-private:
-  cv::SVM *_svm;
+  size_t supportVectorCount() const;
+
+  // trains with the given C and gamma instead of letting train_auto search them, 0 searches again
+  void setParameters(double c, double gamma);
 
-  cv::SVMParams create();
-  void cleanup();
+protected:
+  virtual void predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const;
+
+private:
+  // gives access to the support vectors and decision functions of CvSVM
+  class ExportableSVM : public cv::SVM
+  {
+  public:
+    bool exportTo(RBFSVMEngine& engine) const;
+  };
+
+  struct SVMModel : public Model
+  {
+    ExportableSVM svm;
+    // empty unless the SVM is a C-SVM with RBF kernel
+    RBFSVMEngine engine;
+  };
+
+  cv::SVMParams createParams() const;
+  // fits the sigmoids of the engine to decision values of SVMs trained on the other folds
+  void calibrate(const cv::Mat& trainingMat, const cv::Mat& labelMat, const cv::SVMParams& params,
+                 RBFSVMEngine& engine) const;
+
+  double _c;
+  double _gamma;
 };
 
 #endif // SVMDIGITCLASSIFIER_HPP
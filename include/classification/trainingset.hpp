@@ -0,0 +1,19 @@
+#ifndef TRAININGSET_HPP__
+#define TRAININGSET_HPP__
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+class TrainingSet
+{
+public:
+
+  // reads the images of the sub directories 1 to 9 of directory into samples[0] to samples[8]
+  static bool load(const std::string& directory, std::vector<cv::Mat> *samples);
+
+  static size_t size(const std::vector<cv::Mat> *samples);
+};
+
+#endif // TRAININGSET_HPP
@@ -13,6 +13,7 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "processthread.hpp"
+#include "../capture/framesource.hpp"
 #include "../imgproc/sudokufinder.hpp"
 #include "../imgproc/digitextractor.hpp"
 #include "../classification/digitclassifier.hpp"
@@ -28,7 +29,7 @@ class MainWindow : public QMainWindow
   Q_OBJECT
 
 public:
-  explicit MainWindow(QWidget *parent = 0);
+  explicit MainWindow(FrameSource *frameSource, QWidget *parent = 0);
   ~MainWindow();
 
   void printOnConsole(const QString &msg);
@@ -2,7 +2,6 @@
 #define PROCESSTHREAD_HPP
 
 #include <QThread>
-#include <QMutex>
 #include <QImage>
 
 #include <opencv2/core/core.hpp>
@@ -12,9 +11,8 @@
 
 #include "../../include/gui/mainwindow.hpp"
 
-#include "../../include/classification/digitclassifier.hpp"
-#include "../../include/imgproc/digitextractor.hpp"
-#include "../../include/imgproc/sudokufinder.hpp"
+#include "../../include/capture/framesource.hpp"
+#include "../../include/pipeline/sudokupipeline.hpp"
 
 class MainWindow;
 
@@ -23,7 +21,7 @@ class ProcessThread : public QObject
   Q_OBJECT
 
 public:
-  ProcessThread(MainWindow *window);
+  ProcessThread(MainWindow *window, FrameSource *frameSource);
   ~ProcessThread();
 
   bool containsDigit(size_t row, size_t col);
@@ -59,31 +57,13 @@ private:
   MainWindow *_mainWindow;
 
   bool _running;
-  bool _classify;
 
-  DigitClassifier *_digitClassifier;
-  SudokuFinder    _sudokuFinder;
-  DigitExtractor  _digitExtractor;
-
-  cv::VideoCapture _videoCapture;
-
-  QMutex _classifierMutex;
-  QMutex _extractorFinderMutex;
-
-  size_t _responseCount;
-  uchar _digitResponses[NUM_ROWS_CELLS][NUM_ROWS_CELLS][NUM_FRAMES_FIXED];
-  bool _digitFixed[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
-  bool _allFixed;
-  bool _fixedSent;
+  SudokuPipeline _pipeline;
+  FrameSource *_frameSource;
 
   uchar _solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
 
-  bool _found;
-  size_t _lostCount;
-
-  void setupResponses();
-
-  void classifyDigits();
+  void emitResult(const PipelineResult& result);
 };
 
 #endif // PROCESSTHREAD_HPP
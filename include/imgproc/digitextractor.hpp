@@ -14,23 +14,66 @@ public:
 
   bool containsDigit(size_t row, size_t col) const;
   bool cell(size_t row, size_t col, cv::Mat& cell) const;
+  // the extracted digit of the cell cropped to its bounding box, without copying
+  bool digit(size_t row, size_t col, cv::Mat& digit) const;
+  // the extracted digit of the cell cropped to its bounding box and scaled to size,
+  // normalized and scaled in a single resampling if the normalization is fused
+  bool digit(size_t row, size_t col, const cv::Size& size, cv::Mat& sample) const;
 
   bool updateCells();
+  // forgets the empty cell decisions and the extracted digits, for a grid that appears anew
+  void reset();
 
   void extractDigit(const cv::Mat& src, cv::Mat& digit) const;
+  void extractDigit(const cv::Mat& src, cv::Mat& digit, cv::Rect& boundingBox) const;
+  // extracts the digit of src, crops it to its bounding box and scales it to size
+  void extractDigit(const cv::Mat& src, const cv::Size& size, cv::Mat& sample) const;
+  void normalizeDigit(const cv::Mat& digit, cv::Mat& normalized, const cv::Size& size) const;
+
+  void setFusedNormalization(bool fused);
+  bool fusedNormalization() const;
 
 private:
 
   bool _prepared;
+  size_t _rectificationId;
+  bool _fusedNormalization;
   cv::Mat _digits[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  cv::Rect _boundingBoxes[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  // the thresholded digits before the fused normalization and its inverse map
+  cv::Mat _masks[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  cv::Mat _normalizations[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool _emptyCells[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
 
-  int _thresholdKSize;
-  cv::Rect _searchRegion;
+  cv::Mat _grayGrid;
+  cv::Mat _gridSum;
+  cv::Mat _gridSquaredSum;
 
   const SudokuFinder& _sudokuFinder;
 
   bool updateCell(size_t row, size_t col);
 
+  // the geometry scales with the cell, so cells sampled smaller than the
+  // training images are thresholded and searched alike
+  cv::Rect searchRegion(int cellSize) const;
+  cv::Rect emptyCheckRegion(int cellSize) const;
+  int thresholdSize(int cellSize) const;
+
+  void resetEmptyCells();
+  bool isEmptyCell(size_t row, size_t col, const cv::Mat& cell);
+  double centerStdDev(size_t row, size_t col, const cv::Mat& cell) const;
+
+  void extractDigit(const cv::Mat& src, cv::Mat& digit, cv::Rect& boundingBox,
+                    cv::Mat& mask, cv::Mat& normalization) const;
+  void extractMask(const cv::Mat& src, cv::Mat& mask) const;
+  void scaleDigit(const cv::Mat& digit, const cv::Rect& boundingBox, const cv::Mat& mask,
+                  const cv::Mat& normalization, const cv::Size& size, cv::Mat& sample) const;
+
+  // inverse map deskewing and centering the digit at the size of the mask
+  cv::Mat normalization(const cv::Mat& mask) const;
+  // bounding box of the mask's pixels mapped by the normalization
+  cv::Rect normalizedBoundingBox(const cv::Mat& mask, const cv::Mat& normalization) const;
+
   void floodExtract(const cv::Mat& src, cv::Mat& dst, const cv::Mat& startPixel, const cv::Rect& startRect) const;
   void floodExtract(const cv::Mat& src, cv::Mat& dst, cv::Mat& visited, int row, int col) const;
 
@@ -38,6 +81,7 @@ private:
   void moveToCenter(cv::Mat& digit) const;
 
   bool containsDigit(const cv::Mat& img) const;
+  cv::Rect boundingBox(const cv::Mat& digit) const;
 };
 
 #endif // DIGITEXTRACTOR_HPP
@@ -9,8 +9,15 @@
 class SudokuFinder
 {
 public:
+
+  enum SceneChange
+  {
+    SCENE_CHANGED,
+    SCENE_MOVED,
+    SCENE_STATIC
+  };
   
-  SudokuFinder(size_t cell_size);
+  SudokuFinder(size_t cell_size, size_t cell_sample_size = 0);
   ~SudokuFinder();
   
   bool updateFrame(const cv::Mat& frame);
@@ -23,36 +30,78 @@ public:
   
   size_t getCellSize() const;
   size_t getRectificationSize() const;
+  bool directCellSampling() const;
+  // 0 rectifies the whole grid, otherwise each cell is sampled from the frame at this size
+  void setCellSampleSize(size_t cell_sample_size);
+
+  SceneChange getSceneChange() const;
+  bool rectificationUnchanged() const;
+  size_t getRectificationId() const;
+
+  // takes over what the stages after the detection read of the last frame, the
+  // frame, the contour, the rectification and the cells, sharing their buffers;
+  // the search and tracking state is left out
+  void copyResults(const SudokuFinder& other);
+  // gives the rectification or the cells, whichever the cell sampling uses, buffers
+  // of their own, since the finder that detected them reuses its buffers
+  void detach();
   
   bool cell(size_t row, size_t col, cv::Mat& cell) const;
   
   const Contour<int>& getFoundSudokuContour() const;
+
+  // copies the solution where its mask is set into the frame, warping only the
+  // bounding box of the grid's corners; homography maps frame to solution coordinates
+  static void overlaySolution(const cv::Mat& solution, const cv::Mat& solutionMask,
+                              const cv::Mat& homography, const Contour<float>& corners, cv::Mat& frame);
   
 private:
   
   bool _found;
+  bool _unchanged;
+  size_t _rectificationId;
+  SceneChange _sceneChange;
 
   bool _showSolution;
   uchar _solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  cv::Mat _solutionMat;
+  cv::Mat _solutionMask;
   
   size_t _rectificationSize;
   size_t _cellSize;
+  size_t _cellSampleSize;
+  bool _directCellSampling;
   
   cv::Mat _frame;
+  cv::Mat _grayFrame;
   cv::Mat _preparedFrame;
   cv::Mat _rectifiedSudoku;
+  cv::Mat _cells[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
   
   Contour<int> _foundContour;
   
   Contour<float> _transformedRect;
   Contour<float> _perspectiveRect;
   cv::Mat _homography;
+
+  Contour<float> _previousPerspectiveRect;
+  cv::Rect _previousQuadRect;
+  cv::Mat _previousQuadContent;
+
+  cv::Mat _sceneThumbnail;
+  cv::Mat _sceneReference;
   
-  void prepareFrame();
+  void prepareFrame(const cv::Rect& roi);
+
+  SceneChange detectSceneChange();
+  cv::Rect trackingRoi() const;
 
-  bool findSudoku();
+  bool findSudoku(const cv::Point& offset);
   void transformSudoku();
+  void sampleCells();
+  bool isStationary() const;
 
+  void renderSolution();
   void transformSolutionToFrame();
 };
 
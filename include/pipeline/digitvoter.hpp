@@ -0,0 +1,30 @@
+#ifndef DIGITVOTER_HPP__
+#define DIGITVOTER_HPP__
+
+#include "../classification/digitclassifier.hpp"
+
+// Combines the classifications of one cell over several frames and decides
+// when its digit is certain enough to be fixed.
+class DigitVoter
+{
+public:
+  DigitVoter();
+  virtual ~DigitVoter();
+
+  virtual void reset();
+  // returns true once the digit is fixed, fresh is false for a classification
+  // reused from an earlier frame, which adds no new evidence
+  virtual bool add(const Classification& classification, bool fresh) = 0;
+
+  virtual uchar digit() const = 0;
+  virtual float confidence() const = 0;
+
+  size_t frames() const;
+
+  static DigitVoter* create();
+
+protected:
+  size_t _frames;
+};
+
+#endif // DIGITVOTER_HPP
@@ -0,0 +1,27 @@
+#ifndef EXACTDIGITVOTER_HPP__
+#define EXACTDIGITVOTER_HPP__
+
+#include "digitvoter.hpp"
+#include "../settings.hpp"
+
+// Fixes a digit once the last NUM_FRAMES_FIXED responses are identical.
+class ExactDigitVoter : public DigitVoter
+{
+public:
+  ExactDigitVoter();
+  virtual ~ExactDigitVoter();
+
+  virtual void reset();
+  virtual bool add(const Classification& classification, bool fresh);
+
+  virtual uchar digit() const;
+  virtual float confidence() const;
+
+private:
+  uchar _responses[NUM_FRAMES_FIXED];
+  size_t _responseCount;
+  uchar _digit;
+  size_t _votes;
+};
+
+#endif // EXACTDIGITVOTER_HPP
@@ -0,0 +1,37 @@
+#ifndef LIKELIHOODDIGITVOTER_HPP__
+#define LIKELIHOODDIGITVOTER_HPP__
+
+#include "digitvoter.hpp"
+#include "../settings.hpp"
+
+// Sums the log probabilities of every digit and of an empty cell over the
+// frames and fixes the best one as soon as its likelihood ratio against the
+// runner-up exceeds VOTING_LOG_LIKELIHOOD_RATIO, a sequential probability
+// ratio test. Only fresh classifications and the first one after a reset add
+// evidence, a cell whose reused classification repeats for NUM_FRAMES_FIXED
+// frames is fixed as it stands.
+// The scores are taken as calibrated per frame probabilities,
+// see RBFSVMEngine; uncalibrated scores near 1/9 barely move the ratio.
+class LikelihoodDigitVoter : public DigitVoter
+{
+public:
+  LikelihoodDigitVoter();
+  virtual ~LikelihoodDigitVoter();
+
+  virtual void reset();
+  virtual bool add(const Classification& classification, bool fresh);
+
+  virtual uchar digit() const;
+  virtual float confidence() const;
+
+private:
+  // index 0 is the empty cell, the others are the digits
+  double _logLikelihoods[NUM_DIGITS + 1];
+  size_t _best;
+  size_t _second;
+  size_t _evidenceFrames;
+  uchar _label;
+  size_t _repeats;
+};
+
+#endif // LIKELIHOODDIGITVOTER_HPP
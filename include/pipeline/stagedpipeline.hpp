@@ -0,0 +1,84 @@
+#ifndef STAGEDPIPELINE_HPP__
+#define STAGEDPIPELINE_HPP__
+
+#include "../capture/framesource.hpp"
+#include "../utils/latestslot.hpp"
+#include "sudokupipeline.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Runs capture, detection, recognition and rendering of a SudokuPipeline on
+// one thread each. Live sources drop frames a busy stage has not picked up
+// yet, all other sources are processed frame by frame.
+class StagedPipeline
+{
+public:
+  typedef std::function<void (const PipelineFrame&)> FrameCallback;
+
+  StagedPipeline(SudokuPipeline& pipeline, FrameSource& frameSource);
+  ~StagedPipeline();
+
+  StagedPipeline(const StagedPipeline&) = delete;
+  StagedPipeline& operator=(const StagedPipeline&) = delete;
+
+  // the callback runs on the render thread
+  void start(const FrameCallback& callback);
+  void stop();
+  void wait();
+
+  bool isRunning() const;
+
+  size_t capturedFrames() const;
+  size_t renderedFrames() const;
+  size_t droppedFrames() const;
+
+  // time from capturing a frame until the callback handed it on
+  double lastLatencyMs() const;
+  double meanLatencyMs() const;
+  double maxLatencyMs() const;
+
+private:
+  SudokuPipeline& _pipeline;
+  FrameSource& _frameSource;
+  bool _lossless;
+
+  FrameCallback _callback;
+
+  LatestSlot<PipelineFrame> _captured;
+  LatestSlot<PipelineFrame> _detected;
+  LatestSlot<PipelineFrame> _recognized;
+
+  std::atomic<bool> _running;
+  std::atomic<bool> _captureDone;
+  std::atomic<bool> _detectDone;
+  std::atomic<bool> _recognizeDone;
+  std::atomic<bool> _renderDone;
+
+  std::atomic<size_t> _capturedFrames;
+  std::atomic<size_t> _renderedFrames;
+  std::atomic<size_t> _droppedFrames;
+
+  double _lastLatencyMs;
+  double _latencySumMs;
+  double _maxLatencyMs;
+  mutable std::mutex _latencyMutex;
+
+  std::thread _captureThread;
+  std::thread _detectThread;
+  std::thread _recognizeThread;
+  std::thread _renderThread;
+
+  void capture();
+  void detect();
+  void recognize();
+  void render();
+
+  void publish(LatestSlot<PipelineFrame>& slot, std::unique_ptr<PipelineFrame> frame);
+  std::unique_ptr<PipelineFrame> take(LatestSlot<PipelineFrame>& slot, const std::atomic<bool>& upstreamDone);
+};
+
+#endif // STAGEDPIPELINE_HPP
@@ -0,0 +1,169 @@
+#ifndef SUDOKUPIPELINE_HPP__
+#define SUDOKUPIPELINE_HPP__
+
+#include "../settings.hpp"
+#include "../imgproc/sudokufinder.hpp"
+#include "../imgproc/digitextractor.hpp"
+#include "../classification/classifierbackend.hpp"
+#include "../classification/digitclassifier.hpp"
+#include "../classification/classificationcache.hpp"
+#include "digitvoter.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct PipelineResult
+{
+  // keeps the events of an older result that is dropped in favour of this one
+  void mergeDropped(const PipelineResult& older);
+
+  bool found;
+  bool appeared;
+  bool disappeared;
+
+  uchar digits[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  float confidences[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool updated[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool fixed[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool newlyFixed[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+
+  bool allFixed;
+  bool allDigitsFixed;
+
+  bool solved;
+  uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+};
+
+struct PipelineFrame
+{
+  PipelineFrame() : sequence(0), captureTicks(0), result()
+  {
+  }
+
+  // milliseconds since the frame was captured
+  double ageMs() const;
+
+  size_t sequence;
+  int64 captureTicks;
+
+  cv::Mat frame;
+  std::shared_ptr<SudokuFinder> finder;
+  PipelineResult result;
+};
+
+class SudokuPipeline
+{
+public:
+  SudokuPipeline();
+  ~SudokuPipeline();
+
+  bool process(const cv::Mat& frame, PipelineResult& result);
+  const cv::Mat& getFrame() const;
+
+  // the stages of process(), each stage may run on its own thread
+  void detect(PipelineFrame& frame);
+  void recognize(PipelineFrame& frame);
+  void render(PipelineFrame& frame) const;
+
+  void reset();
+
+  bool solve();
+  void showSolution(const uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS]);
+  void unshowSolution();
+  void setAutoSolve(bool autoSolve);
+
+  // replaces the classifier with an untrained one of the given backend
+  void setClassifierBackend(ClassifierBackend::Type backend);
+  ClassifierBackend::Type classifierBackend() const;
+
+  void train(const std::vector<cv::Mat> *trainingImages);
+  bool loadClassifier(const std::string& filename);
+  bool saveClassifier(const std::string& filename) const;
+  bool hasClassifier() const;
+  // features the classifier is trained with from now on
+  void setClassifierFeatures(DigitFeatures::Type features);
+
+  bool containsDigit(size_t row, size_t col) const;
+  bool cell(size_t row, size_t col, cv::Mat& cell) const;
+  bool preparedCell(size_t row, size_t col, cv::Mat& cell) const;
+  uchar getDigit(size_t row, size_t col);
+
+  size_t getCellSize() const;
+  // 0 rectifies the whole grid, otherwise cells are sampled from the frame at
+  // this size; belongs to the detection stage, so set it before processing
+  void setCellSampleSize(size_t cellSampleSize);
+
+  size_t sceneChangeCount(SudokuFinder::SceneChange sceneChange) const;
+  // fraction of frames that were tracked or reused instead of searched
+  double skipRatio() const;
+
+  // mean number of classified frames until a cell's digit was fixed
+  double meanFramesToLock() const;
+  // number of recognized frames until the last sudoku had all digits fixed
+  size_t lastGridFramesToLock() const;
+
+  // fraction of cell classifications answered by the classification cache
+  double cacheHitRate() const;
+
+  // fraction of the digits the cascade classifier passed on to the SVM, 0 for the other backends
+  double escalationRate() const;
+
+private:
+  // detection stage
+  SudokuFinder _sudokuFinder;
+  bool _found;
+  size_t _lostCount;
+  std::atomic<size_t> _sceneChangeCounts[3];
+
+  // recognition stage
+  SudokuFinder    _cellFinder;
+  DigitExtractor  _digitExtractor;
+  ClassifierBackend::Type _classifierBackend;
+  std::shared_ptr<DigitClassifier> _digitClassifier;
+  ClassificationCache _classificationCache;
+
+  bool _autoSolve;
+
+  size_t _responseCount;
+  std::unique_ptr<DigitVoter> _digitVoters[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  Classification _lastClassifications[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  // classified in this frame rather than reused from the cache or the last frame
+  bool _freshClassifications[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool _lastDigitsValid;
+  size_t _lastRectificationId;
+  size_t _lastModelGeneration;
+  bool _digitFixed[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  uchar _fixedDigits[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+  bool _allFixed;
+  bool _fixedSent;
+
+  size_t _lockedCells;
+  size_t _framesToLockSum;
+  size_t _lastGridFramesToLock;
+
+  mutable std::mutex _recognitionMutex;
+
+  // solution shared between recognition and detection
+  bool _solved;
+  bool _solutionPending;
+  uchar _solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+
+  mutable std::mutex _solutionMutex;
+
+  cv::Mat _outputFrame;
+
+  std::shared_ptr<DigitClassifier> classifier() const;
+
+  void resetResponses();
+  void applySolution();
+
+  void classifyDigits(PipelineResult& result);
+  void fillResult(PipelineResult& result) const;
+};
+
+#endif // SUDOKUPIPELINE_HPP
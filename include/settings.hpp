@@ -2,15 +2,54 @@
 #define SETTINGS_HPP__
 
 #define CAM_NUM 0
+#define FRAME_DELAY_MS 20
 
 #define SUDOKU_CELL_WORKING_SIZE 40
+// 0 rectifies the whole grid, otherwise each cell is sampled straight from the frame at this size
+#define DIRECT_CELL_SAMPLE_SIZE 0
 
 #define DIGIT_SAMPLE_WIDTH 16
+// features of newly trained models: 0 the sample's pixels, 1 histograms of oriented gradients
+#define DIGIT_FEATURES 0
+// HOG cells per side of a sample, 2x2 cells form a block and 9 orientations make 144 values
+#define HOG_CELLS 4
+#define HOG_BINS 9
+#define FUSED_DIGIT_NORMALIZATION 1
 #define PCA_COMPONENTS 0
 
+// classifier of the pipeline: 0 kNN, 1 SVM, 2 MLP, 3 MLP with the cells it is unsure about classified again by the SVM
+#define CLASSIFIER_BACKEND 1
+// the cascade passes cells the MLP gives a lower calibrated probability to the SVM
+#define CASCADE_MIN_CONFIDENCE 0.9
+
 #define KNN_K 4
+// the kNN searches a KD-tree for training sets of at least KNN_INDEX_MIN_SAMPLES samples with at most
+// KNN_INDEX_MAX_DIMENSIONS values, e.g. after PCA, and compares all samples otherwise
+#define KNN_INDEX_MIN_SAMPLES 2000
+#define KNN_INDEX_MAX_DIMENSIONS 64
+#define KNN_INDEX_TREES 4
+// leaves the KD-tree search visits, more is slower and closer to the exact neighbours
+#define KNN_INDEX_CHECKS 128
+// 1 runs the MLP with int8 weights and activations
+#define NN_QUANTIZED 1
+// the softmax temperature of the MLP outputs is fitted on held-out outputs of this many folds
+#define NN_CALIBRATION_FOLDS 5
+
+// cells whose downsampled digit differs in at most this many of 64 bits reuse their last classification, -1 disables the cache
+#define CLASSIFICATION_CACHE_MAX_DISTANCE 2
+// slope of the sigmoid turning SVM decision values into pairwise probabilities for models saved
+// without fitted sigmoids, close to the slopes fitted on the training set
+#define SVM_DECISION_SLOPE 5.0
+// training fits the sigmoids to decision values cross validated over this many folds
+#define SVM_CALIBRATION_FOLDS 5
+// samples whose kernel values the SVM computes together while a support vector is in cache
+#define SVM_BATCH_SIZE 8
 
 #define NO_DIGIT_FOUND 0
+#define NUM_DIGITS 9
+
+#define EMPTY_CELL_ENTER_STDDEV 8.0
+#define EMPTY_CELL_LEAVE_STDDEV 14.0
 
 #define CANNY_LOW  40
 #define CANNY_HIGH 80
@@ -18,6 +57,15 @@
 #define MIN_CONTOUR_AREA 1000
 #define MAX_CONTOUR_CONVEXITY_DEFECT 2000
 
+#define MAX_STATIONARY_CORNER_SHIFT 0.5
+#define MAX_STATIONARY_MEAN_DIFF 2.0
+
+// mean gray difference of downsampled frames below which the last result is reused or only tracked
+#define SCENE_THUMBNAIL_WIDTH 64
+#define MAX_STATIC_SCENE_DIFF 1.0
+#define MAX_TRACKING_SCENE_DIFF 8.0
+#define TRACKING_ROI_MARGIN 0.15
+
 #define NUM_ROWS_CELLS 9
 #define BOX_WIDTH 0
 #define BOX_HEIGHT 0
@@ -29,4 +77,12 @@
 #define NUM_FRAMES_FIXED 15
 #define NUM_FRAMES_LOST 10
 
+// 0 fixes a digit after NUM_FRAMES_FIXED identical responses, 1 once the accumulated evidence suffices
+#define LIKELIHOOD_VOTING 1
+#define VOTING_MIN_FRAMES 3
+// log of the likelihood ratio between the best and the second best digit that fixes a cell
+#define VOTING_LOG_LIKELIHOOD_RATIO 9.2
+#define VOTING_EMPTY_CELL_ERROR 0.02
+#define VOTING_MIN_PROBABILITY 0.001
+
 #endif
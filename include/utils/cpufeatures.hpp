@@ -0,0 +1,18 @@
+#ifndef CPUFEATURES_HPP__
+#define CPUFEATURES_HPP__
+
+// AVX2 kernels are compiled next to the scalar code with a target attribute
+// and only called when the CPU supports them, so one binary runs everywhere.
+#if defined(USE_AVX2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_AVX2_KERNELS
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+class CPUFeatures
+{
+public:
+  // true if the kernels were built and the CPU has AVX2 and FMA
+  static bool hasAVX2();
+};
+
+#endif // CPUFEATURES_HPP
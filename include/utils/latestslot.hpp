@@ -0,0 +1,90 @@
+#ifndef LATESTSLOT_HPP__
+#define LATESTSLOT_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+// Single element exchange between two threads. Publishing replaces an item
+// the consumer has not taken yet, so the consumer always gets the newest one.
+// The exchange itself is lock-free, the mutex only serves threads that block
+// in waitUntil() until the slot changes.
+template<typename T>
+class LatestSlot
+{
+public:
+  LatestSlot() : _item(nullptr), _dropped(0)
+  {
+  }
+
+  ~LatestSlot()
+  {
+    delete _item.exchange(nullptr);
+  }
+
+  LatestSlot(const LatestSlot&) = delete;
+  LatestSlot& operator=(const LatestSlot&) = delete;
+
+  void publish(std::unique_ptr<T> item)
+  {
+    T *old = _item.exchange(item.release(), std::memory_order_acq_rel);
+    if (old)
+    {
+      delete old;
+      ++_dropped;
+    }
+
+    wake();
+  }
+
+  std::unique_ptr<T> take()
+  {
+    std::unique_ptr<T> item(_item.exchange(nullptr, std::memory_order_acq_rel));
+    if (item)
+      wake();
+
+    return item;
+  }
+
+  // blocks until condition holds, it is checked again whenever an item is
+  // published or taken and on every wake()
+  template<typename Condition>
+  void waitUntil(Condition condition)
+  {
+    std::unique_lock<std::mutex> lock(_waitMutex);
+    _changed.wait(lock, condition);
+  }
+
+  // lets waiting threads check their condition again, has to be called after
+  // anything else the condition depends on changed
+  void wake()
+  {
+    // a waiter that saw the old state is either still holding the mutex or
+    // already waiting, so the notification cannot get lost in between
+    {
+      std::lock_guard<std::mutex> lock(_waitMutex);
+    }
+    _changed.notify_all();
+  }
+
+  bool empty() const
+  {
+    return _item.load(std::memory_order_acquire) == nullptr;
+  }
+
+  size_t dropped() const
+  {
+    return _dropped.load();
+  }
+
+private:
+  std::atomic<T*> _item;
+  std::atomic<size_t> _dropped;
+
+  std::mutex _waitMutex;
+  std::condition_variable _changed;
+};
+
+#endif // LATESTSLOT_HPP
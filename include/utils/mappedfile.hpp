@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_HPP__
+#define MAPPEDFILE_HPP__
+
+#include <string>
+#include <vector>
+
+// A read-only file mapped into memory. Without mmap the file is read into a buffer.
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const std::string& filename);
+  void close();
+
+  bool isOpen() const;
+  const char* data() const;
+  size_t size() const;
+
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char *_data;
+  size_t _size;
+  bool _mapped;
+
+  std::vector<char> _buffer;
+};
+
+#endif // MAPPEDFILE_HPP
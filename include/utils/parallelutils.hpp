@@ -0,0 +1,38 @@
+#ifndef PARALLELUTILS_HPP__
+#define PARALLELUTILS_HPP__
+
+#include <opencv2/core/core.hpp>
+
+class ParallelUtils
+{
+public:
+
+  // calls f(i) for every i in [0, n) on OpenCV's worker threads
+  template<typename F>
+  static void parallelFor(int n, const F& f)
+  {
+    cv::parallel_for_(cv::Range(0, n), LoopBody<F>(f));
+  }
+
+private:
+
+  template<typename F>
+  class LoopBody : public cv::ParallelLoopBody
+  {
+  public:
+    LoopBody(const F& f) : _f(f)
+    {
+    }
+
+    virtual void operator()(const cv::Range& range) const
+    {
+      for (int i = range.start; i < range.end; ++i)
+        _f(i);
+    }
+
+  private:
+    const F& _f;
+  };
+};
+
+#endif // PARALLELUTILS_HPP
@@ -0,0 +1,55 @@
+#include "../../include/capture/framesource.hpp"
+#include "../../include/capture/videoframesource.hpp"
+#include "../../include/capture/latestframesource.hpp"
+#include "../../include/capture/imagedirframesource.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+FrameSource::FrameSource(Pacing pacing)
+  : _pacing(pacing)
+{
+}
+
+FrameSource::~FrameSource()
+{
+}
+
+bool FrameSource::readTimestamped(cv::Mat& frame, int64& captureTicks)
+{
+  if (! read(frame))
+    return false;
+
+  captureTicks = cv::getTickCount();
+  return true;
+}
+
+size_t FrameSource::droppedFrames() const
+{
+  return 0;
+}
+
+FrameSource::Pacing FrameSource::getPacing() const
+{
+  return _pacing;
+}
+
+void FrameSource::setPacing(Pacing pacing)
+{
+  _pacing = pacing;
+}
+
+FrameSource* FrameSource::open(const std::string& location, Pacing pacing)
+{
+  if (! location.empty() && std::all_of(std::begin(location), std::end(location), ::isdigit))
+    return new LatestFrameSource(new VideoFrameSource(std::atoi(location.c_str()), pacing));
+
+  struct stat info;
+  if (stat(location.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+    return new ImageDirFrameSource(location, pacing);
+
+  return new VideoFrameSource(location, pacing);
+}
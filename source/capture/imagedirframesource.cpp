@@ -0,0 +1,71 @@
+#include "../../include/capture/imagedirframesource.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+#include <cctype>
+
+static bool isImageFile(const std::string& filename)
+{
+  size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+
+  std::string extension = filename.substr(dot + 1);
+  std::transform(std::begin(extension), std::end(extension), std::begin(extension), ::tolower);
+
+  return extension == "png" || extension == "jpg" || extension == "jpeg"
+      || extension == "bmp" || extension == "ppm" || extension == "pgm";
+}
+
+ImageDirFrameSource::ImageDirFrameSource(const std::string& directory, Pacing pacing)
+  : FrameSource(pacing),
+    _directory(directory),
+    _position(0)
+{
+  std::vector<std::string> files;
+  try
+  {
+    cv::glob(directory + "/*", files);
+  }
+  catch (...)
+  {
+    return;
+  }
+
+  // cv::glob sorts its result, so frames are replayed in file name order
+  for (const std::string& file : files)
+    if (isImageFile(file))
+      _files.push_back(file);
+}
+
+ImageDirFrameSource::~ImageDirFrameSource()
+{
+}
+
+bool ImageDirFrameSource::isOpened() const
+{
+  return ! _files.empty();
+}
+
+bool ImageDirFrameSource::read(cv::Mat& frame)
+{
+  while (_position < _files.size())
+  {
+    frame = cv::imread(_files[_position++], CV_LOAD_IMAGE_COLOR);
+    if (! frame.empty())
+      return true;
+  }
+
+  return false;
+}
+
+bool ImageDirFrameSource::isLive() const
+{
+  return false;
+}
+
+std::string ImageDirFrameSource::description() const
+{
+  return _directory;
+}
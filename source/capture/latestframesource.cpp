@@ -0,0 +1,88 @@
+#include "../../include/capture/latestframesource.hpp"
+
+#include <memory>
+
+LatestFrameSource::LatestFrameSource(FrameSource *source)
+  : FrameSource(source->getPacing()),
+    _source(source),
+    _latest(),
+    _running(source->isOpened()),
+    _ended(! source->isOpened())
+{
+  if (_running)
+    _captureThread = std::thread(&LatestFrameSource::capture, this);
+}
+
+LatestFrameSource::~LatestFrameSource()
+{
+  _running = false;
+  if (_captureThread.joinable())
+    _captureThread.join();
+
+  delete _source;
+}
+
+bool LatestFrameSource::isOpened() const
+{
+  return _source->isOpened();
+}
+
+bool LatestFrameSource::read(cv::Mat& frame)
+{
+  int64 captureTicks;
+  return readTimestamped(frame, captureTicks);
+}
+
+bool LatestFrameSource::readTimestamped(cv::Mat& frame, int64& captureTicks)
+{
+  std::unique_ptr<CapturedFrame> captured = _latest.take();
+  while (! captured)
+  {
+    if (_ended)
+    {
+      // the last frame may have been published right before the source ended
+      captured = _latest.take();
+      if (! captured)
+        return false;
+      break;
+    }
+
+    _latest.waitUntil([&]() { return ! _latest.empty() || _ended; });
+    captured = _latest.take();
+  }
+
+  frame = captured->frame;
+  captureTicks = captured->captureTicks;
+  return true;
+}
+
+bool LatestFrameSource::isLive() const
+{
+  return _source->isLive();
+}
+
+std::string LatestFrameSource::description() const
+{
+  return _source->description();
+}
+
+size_t LatestFrameSource::droppedFrames() const
+{
+  return _latest.dropped();
+}
+
+void LatestFrameSource::capture()
+{
+  // keeps reading, so the device never queues up frames while the consumer is busy
+  while (_running)
+  {
+    std::unique_ptr<CapturedFrame> captured(new CapturedFrame());
+    if (! _source->readTimestamped(captured->frame, captured->captureTicks))
+      break;
+
+    _latest.publish(std::move(captured));
+  }
+
+  _ended = true;
+  _latest.wake();
+}
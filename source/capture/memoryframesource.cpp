@@ -0,0 +1,45 @@
+#include "../../include/capture/memoryframesource.hpp"
+
+#include <sstream>
+
+MemoryFrameSource::MemoryFrameSource(const std::vector<cv::Mat>& frames, Pacing pacing)
+  : FrameSource(pacing),
+    _frames(frames),
+    _position(0)
+{
+}
+
+MemoryFrameSource::~MemoryFrameSource()
+{
+}
+
+bool MemoryFrameSource::isOpened() const
+{
+  return ! _frames.empty();
+}
+
+bool MemoryFrameSource::read(cv::Mat& frame)
+{
+  if (_position >= _frames.size())
+    return false;
+
+  _frames[_position++].copyTo(frame);
+  return true;
+}
+
+bool MemoryFrameSource::isLive() const
+{
+  return false;
+}
+
+std::string MemoryFrameSource::description() const
+{
+  std::stringstream ss;
+  ss << _frames.size() << " frames in memory";
+  return ss.str();
+}
+
+void MemoryFrameSource::rewind()
+{
+  _position = 0;
+}
@@ -0,0 +1,45 @@
+#include "../../include/capture/videoframesource.hpp"
+
+#include <sstream>
+
+VideoFrameSource::VideoFrameSource(int camera, Pacing pacing)
+  : FrameSource(pacing),
+    _videoCapture(camera),
+    _live(true)
+{
+  std::stringstream ss;
+  ss << "camera " << camera;
+  _description = ss.str();
+}
+
+VideoFrameSource::VideoFrameSource(const std::string& filename, Pacing pacing)
+  : FrameSource(pacing),
+    _videoCapture(filename),
+    _live(false),
+    _description(filename)
+{
+}
+
+VideoFrameSource::~VideoFrameSource()
+{
+}
+
+bool VideoFrameSource::isOpened() const
+{
+  return _videoCapture.isOpened();
+}
+
+bool VideoFrameSource::read(cv::Mat& frame)
+{
+  return _videoCapture.read(frame) && ! frame.empty();
+}
+
+bool VideoFrameSource::isLive() const
+{
+  return _live;
+}
+
+std::string VideoFrameSource::description() const
+{
+  return _description;
+}
@@ -0,0 +1,224 @@
+#include "../../include/classification/binarymodel.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+  const char MAGIC[8] = {'V', 'S', 'U', 'D', 'O', 'K', 'U', 'M'};
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  uint64_t aligned(uint64_t offset)
+  {
+    return (offset + BINARY_MODEL_ALIGNMENT - 1) / BINARY_MODEL_ALIGNMENT * BINARY_MODEL_ALIGNMENT;
+  }
+
+  // the header of version 1 files, written before the features were selectable
+  struct BinaryModelHeaderV1
+  {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t type;
+
+    uint32_t sampleWidth;
+    uint32_t pcaComponents;
+
+    uint32_t varCount;
+    uint32_t stride;
+    uint32_t svCount;
+    uint32_t classCount;
+    uint32_t coefficientCount;
+    float gamma;
+
+    uint64_t offsets[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+    uint64_t sizes[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+  };
+
+  // the header of version 2 files, written before the sigmoids were stored
+  struct BinaryModelHeaderV2
+  {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t type;
+
+    uint32_t sampleWidth;
+    uint32_t features;
+    uint32_t pcaComponents;
+
+    uint32_t varCount;
+    uint32_t stride;
+    uint32_t svCount;
+    uint32_t classCount;
+    uint32_t coefficientCount;
+    float gamma;
+
+    uint64_t offsets[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+    uint64_t sizes[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+  };
+
+  // version 1 models were all trained on the pixels, features 0
+  void upgrade(const BinaryModelHeaderV1& old, BinaryModelHeader& header)
+  {
+    header = BinaryModelHeader();
+    header.version = old.version;
+    header.type = old.type;
+    header.sampleWidth = old.sampleWidth;
+    header.features = 0;
+    header.pcaComponents = old.pcaComponents;
+    header.varCount = old.varCount;
+    header.stride = old.stride;
+    header.svCount = old.svCount;
+    header.classCount = old.classCount;
+    header.coefficientCount = old.coefficientCount;
+    header.gamma = old.gamma;
+    for (size_t i = 0; i <= BinaryModelHeader::SECTION_SUPPORT_VECTORS; ++i)
+    {
+      header.offsets[i] = old.offsets[i];
+      header.sizes[i] = old.sizes[i];
+    }
+  }
+
+  void upgrade(const BinaryModelHeaderV2& old, BinaryModelHeader& header)
+  {
+    header = BinaryModelHeader();
+    header.version = old.version;
+    header.type = old.type;
+    header.sampleWidth = old.sampleWidth;
+    header.features = old.features;
+    header.pcaComponents = old.pcaComponents;
+    header.varCount = old.varCount;
+    header.stride = old.stride;
+    header.svCount = old.svCount;
+    header.classCount = old.classCount;
+    header.coefficientCount = old.coefficientCount;
+    header.gamma = old.gamma;
+    for (size_t i = 0; i <= BinaryModelHeader::SECTION_SUPPORT_VECTORS; ++i)
+    {
+      header.offsets[i] = old.offsets[i];
+      header.sizes[i] = old.sizes[i];
+    }
+  }
+}
+
+BinaryModelHeader::BinaryModelHeader()
+{
+  memset(this, 0, sizeof(*this));
+  memcpy(magic, MAGIC, sizeof(magic));
+  byteOrder = BYTE_ORDER_MARK;
+  version = BINARY_MODEL_VERSION;
+}
+
+BinaryModelWriter::BinaryModelWriter()
+{
+}
+
+BinaryModelHeader& BinaryModelWriter::header()
+{
+  return _header;
+}
+
+void BinaryModelWriter::setSection(BinaryModelHeader::Section section, const void* data, size_t size)
+{
+  const char *bytes = static_cast<const char*>(data);
+  _sections[section].assign(bytes, bytes + size);
+}
+
+bool BinaryModelWriter::write(const std::string& filename) const
+{
+  BinaryModelHeader header = _header;
+  uint64_t offset = aligned(sizeof(header));
+  for (size_t i = 0; i < BinaryModelHeader::SECTION_COUNT; ++i)
+  {
+    header.offsets[i] = offset;
+    header.sizes[i] = _sections[i].size();
+    offset = aligned(offset + _sections[i].size());
+  }
+
+  std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+  if (! file)
+    return false;
+
+  const char padding[BINARY_MODEL_ALIGNMENT] = {0};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(padding, aligned(sizeof(header)) - sizeof(header));
+  for (size_t i = 0; i < BinaryModelHeader::SECTION_COUNT; ++i)
+  {
+    if (! _sections[i].empty())
+      file.write(&_sections[i][0], _sections[i].size());
+    file.write(padding, aligned(_sections[i].size()) - _sections[i].size());
+  }
+
+  return file.good();
+}
+
+bool BinaryModelWriter::isBinaryFilename(const std::string& filename)
+{
+  std::string extension(BINARY_MODEL_EXTENSION);
+  return filename.size() >= extension.size()
+      && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+BinaryModelReader::BinaryModelReader()
+{
+}
+
+bool BinaryModelReader::open(const std::string& filename)
+{
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (! file->open(filename) || file->size() < sizeof(BinaryModelHeaderV1))
+    return false;
+
+  // magic, byte order and version are at the same place in every version
+  BinaryModelHeaderV1 old;
+  memcpy(&old, file->data(), sizeof(old));
+  if (memcmp(old.magic, MAGIC, sizeof(MAGIC)) != 0 || old.byteOrder != BYTE_ORDER_MARK)
+    return false;
+
+  if (old.version == 1)
+  {
+    upgrade(old, _header);
+  }
+  else if (old.version == 2 && file->size() >= sizeof(BinaryModelHeaderV2))
+  {
+    BinaryModelHeaderV2 header;
+    memcpy(&header, file->data(), sizeof(header));
+    upgrade(header, _header);
+  }
+  else if (old.version == BINARY_MODEL_VERSION && file->size() >= sizeof(BinaryModelHeader))
+  {
+    memcpy(&_header, file->data(), sizeof(_header));
+  }
+  else
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < BinaryModelHeader::SECTION_COUNT; ++i)
+  {
+    if (_header.offsets[i] % BINARY_MODEL_ALIGNMENT != 0 || _header.offsets[i] > file->size()
+        || _header.sizes[i] > file->size() - _header.offsets[i])
+      return false;
+  }
+
+  _file = file;
+  return true;
+}
+
+const BinaryModelHeader& BinaryModelReader::header() const
+{
+  return _header;
+}
+
+std::shared_ptr<const MappedFile> BinaryModelReader::file() const
+{
+  return _file;
+}
+
+bool BinaryModelReader::isBinaryModel(const std::string& filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  return file.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
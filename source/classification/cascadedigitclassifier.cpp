@@ -0,0 +1,142 @@
+#include "../../include/classification/cascadedigitclassifier.hpp"
+
+#include <opencv2/core/core.hpp>
+
+// largest difference between the PCA bases of the stages trained on the same samples
+#define MAX_PCA_DIFFERENCE 1e-4
+
+CascadeDigitClassifier::CascadeDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents,
+                                               float minConfidence)
+  : DigitClassifier(extractor, sampleWidth, pcaComponents),
+    _fast(extractor, sampleWidth, pcaComponents, true),
+    _accurate(extractor, sampleWidth, pcaComponents),
+    _minConfidence(minConfidence),
+    _classified(0),
+    _escalated(0)
+{
+}
+
+CascadeDigitClassifier::~CascadeDigitClassifier()
+{
+}
+
+void CascadeDigitClassifier::train(const std::vector<cv::Mat> *trainingImages)
+{
+  _fast.train(trainingImages);
+  _accurate.train(trainingImages);
+  publishStages();
+}
+
+bool CascadeDigitClassifier::load(const std::string& filename)
+{
+  return _accurate.load(filename) && _fast.load(fastStageFilename(filename)) && publishStages();
+}
+
+bool CascadeDigitClassifier::save(const std::string& filename) const
+{
+  if (! hasModel())
+    return false;
+
+  return _accurate.save(filename) && _fast.save(fastStageFilename(filename));
+}
+
+std::string CascadeDigitClassifier::fastStageFilename(const std::string& filename)
+{
+  size_t dot = filename.find_last_of('.');
+  size_t slash = filename.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return filename + ".fast";
+
+  return filename.substr(0, dot) + ".fast" + filename.substr(dot);
+}
+
+void CascadeDigitClassifier::setFeatures(DigitFeatures::Type features)
+{
+  DigitClassifier::setFeatures(features);
+  _fast.setFeatures(features);
+  _accurate.setFeatures(features);
+}
+
+size_t CascadeDigitClassifier::classifiedCount() const
+{
+  return _classified;
+}
+
+size_t CascadeDigitClassifier::escalatedCount() const
+{
+  return _escalated;
+}
+
+double CascadeDigitClassifier::escalationRate() const
+{
+  size_t classified = _classified;
+  return classified > 0 ? static_cast<double>(_escalated) / classified : 0.0;
+}
+
+void CascadeDigitClassifier::predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const
+{
+  const CascadeModel& cascade = static_cast<const CascadeModel&>(model);
+  predictWith(_fast, *cascade.fast, samples, classifications);
+
+  // buffers are kept between the calls like the ones of the engines
+  static thread_local std::vector<int> unsure;
+  static thread_local cv::Mat escalated;
+  static thread_local std::vector<Classification> accurate;
+  unsure.clear();
+  for (size_t i = 0; i < classifications.size(); ++i)
+    if (classifications[i].confidence < _minConfidence)
+      unsure.push_back(i);
+
+  _classified += classifications.size();
+  _escalated += unsure.size();
+  if (unsure.empty())
+    return;
+
+  // the SVM gets only the rows of the unsure digits, so its batches stay full
+  escalated.create(unsure.size(), samples.cols, samples.type());
+  for (size_t i = 0; i < unsure.size(); ++i)
+  {
+    cv::Mat row = escalated.row(i);
+    samples.row(unsure[i]).copyTo(row);
+  }
+
+  accurate.assign(unsure.size(), Classification());
+  predictWith(_accurate, *cascade.accurate, escalated, accurate);
+  for (size_t i = 0; i < unsure.size(); ++i)
+    classifications[unsure[i]] = accurate[i];
+}
+
+bool CascadeDigitClassifier::publishStages()
+{
+  std::shared_ptr<const Model> fast = modelOf(_fast);
+  std::shared_ptr<const Model> accurate = modelOf(_accurate);
+  if (! fast || ! accurate || ! samePreprocessing(*fast, *accurate))
+    return false;
+
+  std::shared_ptr<CascadeModel> model = std::make_shared<CascadeModel>();
+  model->sampleWidth = accurate->sampleWidth;
+  model->features = accurate->features;
+  model->pca = accurate->pca;
+  model->fast = fast;
+  model->accurate = accurate;
+
+  setModel(model);
+  return true;
+}
+
+bool CascadeDigitClassifier::samePreprocessing(const Model& a, const Model& b)
+{
+  if (a.sampleWidth != b.sampleWidth || a.features != b.features || ! a.pca != ! b.pca)
+    return false;
+
+  if (! a.pca)
+    return true;
+
+  // the stages compute their PCA from the same samples, so the bases only differ by rounding
+  const cv::PCA& pcaA = *a.pca;
+  const cv::PCA& pcaB = *b.pca;
+  return pcaA.mean.total() == pcaB.mean.total() && pcaA.mean.type() == pcaB.mean.type()
+      && pcaA.eigenvectors.size() == pcaB.eigenvectors.size() && pcaA.eigenvectors.type() == pcaB.eigenvectors.type()
+      && cv::norm(pcaA.mean.reshape(1, 1), pcaB.mean.reshape(1, 1), cv::NORM_INF) <= MAX_PCA_DIFFERENCE
+      && cv::norm(pcaA.eigenvectors, pcaB.eigenvectors, cv::NORM_INF) <= MAX_PCA_DIFFERENCE;
+}
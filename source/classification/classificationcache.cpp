@@ -0,0 +1,82 @@
+#include "../../include/classification/classificationcache.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <bitset>
+
+#define SIGNATURE_WIDTH 8
+
+ClassificationCache::ClassificationCache()
+  : _lookups(0),
+    _hits(0)
+{
+  clear();
+}
+
+void ClassificationCache::clear()
+{
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      _entries[row][col].valid = false;
+}
+
+uint64 ClassificationCache::signature(const cv::Mat& digit)
+{
+  if (digit.empty())
+    return 0;
+
+  cv::Mat small;
+  cv::resize(digit, small, cv::Size(SIGNATURE_WIDTH, SIGNATURE_WIDTH), 0, 0, cv::INTER_AREA);
+
+  uint64 bits = 0;
+  for (int y = 0; y < SIGNATURE_WIDTH; ++y)
+  {
+    const uchar *row = small.ptr<uchar>(y);
+    for (int x = 0; x < SIGNATURE_WIDTH; ++x)
+      bits = (bits << 1) | (row[x] >= 128 ? 1 : 0);
+  }
+
+  return bits;
+}
+
+bool ClassificationCache::lookup(size_t row, size_t col, uint64 signature, size_t modelGeneration, Classification& classification)
+{
+  ++_lookups;
+
+  const Entry &entry = _entries[row][col];
+  if (! entry.valid || entry.modelGeneration != modelGeneration)
+    return false;
+
+  int distance = std::bitset<64>(entry.signature ^ signature).count();
+  if (distance > CLASSIFICATION_CACHE_MAX_DISTANCE)
+    return false;
+
+  classification = entry.classification;
+  ++_hits;
+  return true;
+}
+
+void ClassificationCache::store(size_t row, size_t col, uint64 signature, size_t modelGeneration, const Classification& classification)
+{
+  Entry &entry = _entries[row][col];
+  entry.valid = true;
+  entry.signature = signature;
+  entry.modelGeneration = modelGeneration;
+  entry.classification = classification;
+}
+
+size_t ClassificationCache::lookups() const
+{
+  return _lookups;
+}
+
+size_t ClassificationCache::hits() const
+{
+  return _hits;
+}
+
+double ClassificationCache::hitRate() const
+{
+  size_t lookups = _lookups;
+  return lookups > 0 ? static_cast<double>(_hits) / lookups : 0.0;
+}
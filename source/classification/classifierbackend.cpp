@@ -0,0 +1,53 @@
+#include "../../include/classification/classifierbackend.hpp"
+#include "../../include/classification/cascadedigitclassifier.hpp"
+#include "../../include/classification/knndigitclassifier.hpp"
+#include "../../include/classification/nndigitclassifier.hpp"
+#include "../../include/classification/svmdigitclassifier.hpp"
+
+DigitClassifier* ClassifierBackend::create(Type type, const DigitExtractor& extractor)
+{
+  switch (type)
+  {
+  case BACKEND_KNN:
+    return new KNNDigitClassifier(extractor, DIGIT_SAMPLE_WIDTH, KNN_K, PCA_COMPONENTS);
+  case BACKEND_NN:
+    return new NNDigitClassifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  case BACKEND_CASCADE:
+    return new CascadeDigitClassifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  case BACKEND_SVM:
+  default:
+    return new SVMDigitClassifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  }
+}
+
+std::string ClassifierBackend::name(Type type)
+{
+  switch (type)
+  {
+  case BACKEND_KNN:
+    return "knn";
+  case BACKEND_NN:
+    return "nn";
+  case BACKEND_CASCADE:
+    return "cascade";
+  case BACKEND_SVM:
+  default:
+    return "svm";
+  }
+}
+
+bool ClassifierBackend::parse(const std::string& name, Type& type)
+{
+  if (name == "knn")
+    type = BACKEND_KNN;
+  else if (name == "svm")
+    type = BACKEND_SVM;
+  else if (name == "nn")
+    type = BACKEND_NN;
+  else if (name == "cascade")
+    type = BACKEND_CASCADE;
+  else
+    return false;
+
+  return true;
+}
@@ -1,67 +1,227 @@
 #include "../../include/classification/digitclassifier.hpp"
+#include "../../include/utils/parallelutils.hpp"
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/objdetect/objdetect.hpp>
 #include <opencv2/ml/ml.hpp>
 
+#include <algorithm>
+#include <numeric>
+
+Classification::Classification()
+  : label(NO_DIGIT_FOUND),
+    confidence(0.f)
+{
+  std::fill(scores, scores + NUM_DIGITS, 0.f);
+}
+
+void Classification::finish(uchar label)
+{
+  float sum = std::accumulate(scores, scores + NUM_DIGITS, 0.f);
+  for (size_t i = 0; i < NUM_DIGITS; ++i)
+    scores[i] = sum > 0.f ? scores[i] / sum : 1.f / NUM_DIGITS;
+
+  this->label = label;
+  confidence = label >= 1 && label <= NUM_DIGITS ? scores[label - 1] : 0.f;
+}
+
+DigitClassifier::Model::Model()
+  : generation(0),
+    sampleWidth(0),
+    features(DigitFeatures::FEATURES_PIXELS)
+{
+}
+
+DigitClassifier::Model::~Model()
+{
+}
+
 DigitClassifier::DigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents)
   : _extractor(extractor),
     _sampleWidth(sampleWidth),
     _pcaComponents(pcaComponents),
-    _pca(nullptr)
+    _features(static_cast<DigitFeatures::Type>(DIGIT_FEATURES)),
+    _model(),
+    _generation(0)
 {
 }
 
 DigitClassifier::~DigitClassifier()
 {
-  if (_pca) delete _pca;
 }
 
-template<typename T>
-cv::Mat DigitClassifier::toRowVector(const cv::Mat& in) const
+std::shared_ptr<const DigitClassifier::Model> DigitClassifier::model() const
 {
-  cv::Mat out;
-  out.create(1, in.rows*in.cols, in.type());
-  int ii = 0;
-  for (int i = 0; i < in.rows; i++) {
-    for (int j = 0; j < in.cols; j++) {
-        out.at<T>(0,ii++) = in.at<T>(i,j);
-    }
+  return std::atomic_load(&_model);
+}
+
+void DigitClassifier::setModel(const std::shared_ptr<Model>& model)
+{
+  model->generation = ++_generation;
+  std::atomic_store(&_model, std::shared_ptr<const Model>(model));
+}
+
+std::shared_ptr<const DigitClassifier::Model> DigitClassifier::modelOf(const DigitClassifier& classifier)
+{
+  return classifier.model();
+}
+
+void DigitClassifier::predictWith(const DigitClassifier& classifier, const Model& model, const cv::Mat& samples,
+                                  std::vector<Classification>& classifications)
+{
+  classifier.predict(model, samples, classifications);
+}
+
+bool DigitClassifier::hasModel() const
+{
+  return model() != nullptr;
+}
+
+size_t DigitClassifier::modelGeneration() const
+{
+  std::shared_ptr<const Model> current = model();
+  return current ? current->generation : 0;
+}
+
+uchar DigitClassifier::classify(const cv::Mat& image) const
+{
+  Classification classification;
+  classify(image, classification);
+
+  return classification.label;
+}
+
+void DigitClassifier::classify(const cv::Mat& image, Classification& classification) const
+{
+  classification = Classification();
+
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return;
+
+  static thread_local std::vector<Classification> classifications;
+  classifications.assign(1, Classification());
+  predict(*current, prepareDigitMat(image, *current), classifications);
+  classification = classifications[0];
+}
+
+void DigitClassifier::classifyBatch(const std::vector<cv::Mat>& images, std::vector<Classification>& classifications) const
+{
+  classifications.assign(images.size(), Classification());
+
+  std::shared_ptr<const Model> current = model();
+  if (! current || images.empty())
+    return;
+
+  predict(*current, prepareDigitBatch(images, *current), classifications);
+}
+
+void DigitClassifier::classifyCells(const std::vector<cv::Point>& cells, std::vector<Classification>& classifications) const
+{
+  classifications.assign(cells.size(), Classification());
+
+  std::shared_ptr<const Model> current = model();
+  if (! current || cells.empty())
+    return;
+
+  // the extractor scales the digits to the sample size together with their normalization
+  cv::Size sampleSize = DigitFeatures::sampleSize(current->features, current->sampleWidth);
+  // the digits keep their buffers between the frames
+  static thread_local std::vector<cv::Mat> digits;
+  digits.resize(cells.size());
+  for (size_t i = 0; i < cells.size(); ++i)
+  {
+    if (! _extractor.digit(cells[i].y, cells[i].x, sampleSize, digits[i]))
+      digits[i].release();
   }
-  return out;
+
+  classifyDigits(*current, digits, classifications);
 }
 
-cv::Mat DigitClassifier::prepareDigitMat(const cv::Mat& in, bool pca) const
+void DigitClassifier::classifyDigits(const std::vector<cv::Mat>& digits, std::vector<Classification>& classifications) const
 {
-  cv::Mat tmp;
-  _extractor.extractDigit(in, tmp);
+  classifications.assign(digits.size(), Classification());
 
-  std::vector<Contour<int>> contours;
-  Contour<int> contour;
-  cv::findContours(tmp.clone(), contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
-  for (auto c : contours)
-    for (auto p : c)
-      contour.push_back(p);
+  std::shared_ptr<const Model> current = model();
+  if (! current || digits.empty())
+    return;
 
-  if (contour.size() > 1)
+  classifyDigits(*current, digits, classifications);
+}
+
+void DigitClassifier::classifyDigits(const Model& model, const std::vector<cv::Mat>& digits,
+                                     std::vector<Classification>& classifications) const
+{
+  // the features are written into rows of a buffer kept between the calls, the
+  // workers of the loop only fill it for the calling thread
+  static thread_local cv::Mat samples, projected;
+  samples.create(digits.size(), featureSize(model), CV_32FC1);
+  ParallelUtils::parallelFor(digits.size(), [&](int i)
   {
-    cv::Rect boundingBox = cv::boundingRect(contour);
-    tmp = tmp(boundingBox);
+    cv::Mat sample = samples.row(i);
+    if (digits[i].empty())
+      sample.setTo(0.f);
+    else
+      prepareExtractedDigit(digits[i], model, sample);
+  });
+
+  if (! model.pca)
+  {
+    predict(model, samples, classifications);
+    return;
   }
 
-  cv::resize(tmp, tmp, cv::Size(_sampleWidth, _sampleWidth));
+  model.pca->project(samples, projected);
+  predict(model, projected, classifications);
+}
 
-  tmp.convertTo(tmp, CV_32FC1, 1.0/255.0);
-  cv::Mat row = toRowVector<float>(tmp);
-  if (! pca || ! usePCA())
-    return row;
+cv::Mat DigitClassifier::prepareDigitMat(const cv::Mat& in, const Model& model) const
+{
+  return projectSamples(prepareSample(in, model), model);
+}
+
+cv::Mat DigitClassifier::prepareSample(const cv::Mat& in, const Model& model) const
+{
+  cv::Mat digit;
+  _extractor.extractDigit(in, DigitFeatures::sampleSize(model.features, model.sampleWidth), digit);
+
+  cv::Mat row;
+  prepareExtractedDigit(digit, model, row);
+  return row;
+}
+
+void DigitClassifier::prepareExtractedDigit(const cv::Mat& digit, const Model& model, cv::Mat& sample) const
+{
+  DigitFeatures::compute(model.features, model.sampleWidth, digit, sample);
+}
+
+cv::Mat DigitClassifier::projectSamples(const cv::Mat& samples, const Model& model) const
+{
+  if (! model.pca)
+    return samples;
   else
-    return _pca->project(row);
+    return model.pca->project(samples);
+}
+
+cv::Mat DigitClassifier::prepareDigitBatch(const std::vector<cv::Mat>& images, const Model& model) const
+{
+  // one sample per row, so PCA projects all of them in a single product
+  cv::Mat samples(images.size(), featureSize(model), CV_32FC1);
+  ParallelUtils::parallelFor(images.size(), [&](int i)
+  {
+    cv::Mat sample = samples.row(i);
+    prepareSample(images[i], model).copyTo(sample);
+  });
+
+  return projectSamples(samples, model);
 }
 
-void DigitClassifier::prepareTrainingMat(const std::vector<cv::Mat>* trainingImages, cv::Mat& trainingMat, cv::Mat& labelMat)
+void DigitClassifier::prepareTrainingMat(const std::vector<cv::Mat>* trainingImages, cv::Mat& trainingMat, cv::Mat& labelMat, Model& model) const
 {
-  size_t w = _sampleWidth * _sampleWidth;
+  model.sampleWidth = _sampleWidth;
+  model.features = _features;
+
+  size_t w = featureSize(model);
   size_t num_samples = 0;
   for (int i = 0; i < 9; ++i)
     num_samples += trainingImages[i].size();
@@ -76,7 +236,7 @@ void DigitClassifier::prepareTrainingMat(const std::vector<cv::Mat>* trainingIma
     auto it = std::begin(trainingImages[i]);
     for (; it != std::end(trainingImages[i]); ++it)
     {
-      cv::Mat prepared = prepareDigitMat(*it, false);
+      cv::Mat prepared = prepareSample(*it, model);
 
       for (int j = 0; j < w; ++j)
         pcaMat.at<float>(row, j) = prepared.at<float>(0, j);
@@ -84,37 +244,159 @@ void DigitClassifier::prepareTrainingMat(const std::vector<cv::Mat>* trainingIma
     }
   }
 
-  if (! usePCA())
+  if (_pcaComponents == 0)
   {
     pcaMat.copyTo(trainingMat);
   }
   else
   {
-    if (_pca) delete _pca;
-
-    _pca = new cv::PCA(pcaMat, cv::noArray(), CV_PCA_DATA_AS_ROW, static_cast<int>(_pcaComponents));
+    model.pca = std::make_shared<cv::PCA>(pcaMat, cv::noArray(), CV_PCA_DATA_AS_ROW, static_cast<int>(_pcaComponents));
     trainingMat.create(pcaMat.rows, _pcaComponents, CV_32FC1);
     for (int i = 0; i < pcaMat.rows; ++i)
     {
       cv::Mat pcaRow = pcaMat.row(i);
-      cv::Mat reduced = _pca->project(pcaRow);
+      cv::Mat reduced = model.pca->project(pcaRow);
       for (int j = 0;  j < reduced.cols; ++j)
         trainingMat.at<float>(i, j) = reduced.at<float>(0, j);
     }
   }
 }
 
+void DigitClassifier::writePreprocessing(const Model& model, BinaryModelWriter& writer) const
+{
+  BinaryModelHeader& header = writer.header();
+  header.sampleWidth = model.sampleWidth;
+  header.features = model.features;
+  header.pcaComponents = model.pca ? model.pca->eigenvectors.rows : 0;
+  if (! model.pca)
+    return;
+
+  cv::Mat mean, eigenvectors;
+  model.pca->mean.reshape(1, 1).convertTo(mean, CV_32F);
+  model.pca->eigenvectors.convertTo(eigenvectors, CV_32F);
+  eigenvectors = eigenvectors.isContinuous() ? eigenvectors : eigenvectors.clone();
+
+  writer.setSection(BinaryModelHeader::SECTION_PCA_MEAN, mean.data, mean.total() * sizeof(float));
+  writer.setSection(BinaryModelHeader::SECTION_PCA_EIGENVECTORS, eigenvectors.data, eigenvectors.total() * sizeof(float));
+}
+
+bool DigitClassifier::readPreprocessing(const BinaryModelReader& reader, Model& model) const
+{
+  const BinaryModelHeader& header = reader.header();
+  if (header.sampleWidth == 0 || header.features > DigitFeatures::FEATURES_HOG)
+    return false;
+
+  model.sampleWidth = header.sampleWidth;
+  model.features = static_cast<DigitFeatures::Type>(header.features);
+  model.file = reader.file();
+  model.pca.reset();
+  if (header.pcaComponents == 0)
+    return true;
+
+  size_t w = featureSize(model);
+  const float *mean = reader.section<float>(BinaryModelHeader::SECTION_PCA_MEAN, w);
+  const float *eigenvectors = reader.section<float>(BinaryModelHeader::SECTION_PCA_EIGENVECTORS, header.pcaComponents * w);
+  if (! mean || ! eigenvectors)
+    return false;
+
+  // the basis stays in the mapped file, projecting only reads it
+  std::shared_ptr<cv::PCA> pca = std::make_shared<cv::PCA>();
+  pca->mean = cv::Mat(1, w, CV_32FC1, const_cast<float*>(mean));
+  pca->eigenvectors = cv::Mat(header.pcaComponents, w, CV_32FC1, const_cast<float*>(eigenvectors));
+  model.pca = pca;
+
+  return true;
+}
+
+size_t DigitClassifier::featureSize(const Model& model) const
+{
+  return DigitFeatures::size(model.features, model.sampleWidth);
+}
+
+size_t DigitClassifier::inputSize(const Model& model) const
+{
+  return model.pca ? model.pca->eigenvectors.rows : featureSize(model);
+}
+
+void DigitClassifier::writePreprocessing(cv::FileStorage& fs, const Model& model) const
+{
+  fs << "preprocessing" << "{";
+  fs << "sampleWidth" << static_cast<int>(model.sampleWidth);
+  fs << "features" << DigitFeatures::name(model.features);
+  fs << "pcaComponents" << (model.pca ? model.pca->eigenvectors.rows : 0);
+  if (model.pca)
+    fs << "pcaMean" << model.pca->mean << "pcaEigenvectors" << model.pca->eigenvectors;
+  fs << "}";
+}
+
+bool DigitClassifier::readPreprocessing(const cv::FileStorage& fs, Model& model) const
+{
+  model.pca.reset();
+
+  // older files hold a classifier for raw samples of the configured width
+  cv::FileNode node = fs["preprocessing"];
+  if (node.empty())
+  {
+    model.sampleWidth = _sampleWidth;
+    model.features = DigitFeatures::FEATURES_PIXELS;
+    return true;
+  }
+
+  int sampleWidth = node["sampleWidth"];
+  int pcaComponents = node["pcaComponents"];
+  if (sampleWidth <= 0 || pcaComponents < 0)
+    return false;
+
+  // models saved before the features were selectable use the pixels
+  std::string features = node["features"].empty() ? "pixels" : static_cast<std::string>(node["features"]);
+  if (! DigitFeatures::parse(features, model.features))
+    return false;
+
+  model.sampleWidth = sampleWidth;
+  if (pcaComponents == 0)
+    return true;
+
+  std::shared_ptr<cv::PCA> pca = std::make_shared<cv::PCA>();
+  node["pcaMean"] >> pca->mean;
+  node["pcaEigenvectors"] >> pca->eigenvectors;
+
+  int w = featureSize(model);
+  if (pca->mean.total() != static_cast<size_t>(w) || pca->eigenvectors.rows != pcaComponents
+      || pca->eigenvectors.cols != w)
+    return false;
+
+  pca->mean = pca->mean.reshape(1, 1);
+  model.pca = pca;
+  return true;
+}
+
+void DigitClassifier::setFeatures(DigitFeatures::Type features)
+{
+  _features = features;
+}
+
+DigitFeatures::Type DigitClassifier::getFeatures() const
+{
+  std::shared_ptr<const Model> current = model();
+  return current ? current->features : _features;
+}
+
 size_t DigitClassifier::getSampleWidth() const
 {
-  return _sampleWidth;
+  std::shared_ptr<const Model> current = model();
+  return current ? current->sampleWidth : _sampleWidth;
 }
 
 size_t DigitClassifier::getPCAComponents() const
 {
-  return _sampleWidth;
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return _pcaComponents;
+
+  return current->pca ? current->pca->eigenvectors.rows : 0;
 }
 
 bool DigitClassifier::usePCA() const
 {
-  return _pcaComponents > 0;
+  return getPCAComponents() > 0;
 }
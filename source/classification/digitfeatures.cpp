@@ -0,0 +1,92 @@
+#include "../../include/classification/digitfeatures.hpp"
+#include "../../include/settings.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/objdetect/objdetect.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+  // the blocks of 2x2 cells do not overlap, so every sample width gives a valid layout
+  cv::HOGDescriptor createHOG(size_t sampleWidth)
+  {
+    int cell = std::max<int>(1, sampleWidth / HOG_CELLS);
+    return cv::HOGDescriptor(cv::Size(cell * HOG_CELLS, cell * HOG_CELLS), cv::Size(2 * cell, 2 * cell),
+                             cv::Size(2 * cell, 2 * cell), cv::Size(cell, cell), HOG_BINS);
+  }
+
+  // HOGDescriptor::compute is const, one descriptor per thread avoids recreating it for every digit
+  const cv::HOGDescriptor& hog(size_t sampleWidth)
+  {
+    static thread_local size_t width = 0;
+    static thread_local std::unique_ptr<cv::HOGDescriptor> descriptor;
+    if (! descriptor || width != sampleWidth)
+    {
+      descriptor.reset(new cv::HOGDescriptor(createHOG(sampleWidth)));
+      width = sampleWidth;
+    }
+
+    return *descriptor;
+  }
+}
+
+size_t DigitFeatures::size(Type type, size_t sampleWidth)
+{
+  if (type == FEATURES_HOG)
+    return (HOG_CELLS / 2) * (HOG_CELLS / 2) * 4 * HOG_BINS;
+  else
+    return sampleWidth * sampleWidth;
+}
+
+cv::Size DigitFeatures::sampleSize(Type type, size_t sampleWidth)
+{
+  if (type == FEATURES_HOG)
+    return hog(sampleWidth).winSize;
+  else
+    return cv::Size(sampleWidth, sampleWidth);
+}
+
+void DigitFeatures::compute(Type type, size_t sampleWidth, const cv::Mat& digit, cv::Mat& features)
+{
+  if (type == FEATURES_HOG)
+  {
+    const cv::HOGDescriptor& descriptor = hog(sampleWidth);
+
+    cv::Mat window = digit;
+    if (window.size() != descriptor.winSize)
+      cv::resize(digit, window, descriptor.winSize);
+
+    static thread_local std::vector<float> values;
+    descriptor.compute(window, values);
+    cv::Mat(values).reshape(1, 1).copyTo(features);
+    return;
+  }
+
+  cv::Mat tmp = digit;
+  cv::Size sampleSize(sampleWidth, sampleWidth);
+  if (tmp.size() != sampleSize)
+    cv::resize(tmp, tmp, sampleSize);
+
+  tmp.convertTo(tmp, CV_32FC1, 1.0/255.0);
+  tmp.reshape(1, 1).copyTo(features);
+}
+
+std::string DigitFeatures::name(Type type)
+{
+  return type == FEATURES_HOG ? "hog" : "pixels";
+}
+
+bool DigitFeatures::parse(const std::string& name, Type& type)
+{
+  if (name == "pixels")
+    type = FEATURES_PIXELS;
+  else if (name == "hog")
+    type = FEATURES_HOG;
+  else
+    return false;
+
+  return true;
+}
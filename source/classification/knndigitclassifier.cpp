@@ -1,53 +1,141 @@
 #include "../../include/classification/knndigitclassifier.hpp"
 
-KNNDigitClassifier::KNNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t k, size_t pcaComponents)
+#include <algorithm>
+
+KNNDigitClassifier::KNNModel::KNNModel()
+  : kdTree(false)
+{
+}
+
+KNNDigitClassifier::KNNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t k, size_t pcaComponents, Search search)
   : DigitClassifier(extractor, sampleWidth, pcaComponents),
-    _knn(nullptr),
-    _k(k)
+    _k(k),
+    _search(search)
 {
 }
 
 KNNDigitClassifier::~KNNDigitClassifier()
 {
-  cleanup();
 }
 
 void KNNDigitClassifier::train(const std::vector<cv::Mat>* trainingImages)
 {
-  create();
+  std::shared_ptr<KNNModel> model = std::make_shared<KNNModel>();
+
+  prepareTrainingMat(trainingImages, model->samples, model->responses, *model);
+  buildIndex(*model);
 
-  cv::Mat trainingMat, labelMat;
-  prepareTrainingMat(trainingImages, trainingMat, labelMat);
-  _knn->train(trainingMat, labelMat);
+  setModel(model);
 }
 
-uchar KNNDigitClassifier::classify(const cv::Mat& image)
+bool KNNDigitClassifier::usesKDTree() const
 {
-  if (! _knn)
-    return NO_DIGIT_FOUND;
-
-  cv::Mat prepared = prepareDigitMat(image);
-  float response = _knn->find_nearest(prepared, std::min(_k, static_cast<size_t>(_knn->get_max_k())));
-
-  return static_cast<uchar>(response);
+  std::shared_ptr<const Model> current = model();
+  return current && static_cast<const KNNModel&>(*current).kdTree;
 }
 
-bool KNNDigitClassifier::load(const std::string& filename)
+void KNNDigitClassifier::buildIndex(KNNModel& model) const
 {
-  return false;
+  // the index keeps pointers into the samples
+  if (! model.samples.isContinuous() || model.samples.type() != CV_32FC1)
+    model.samples.convertTo(model.samples, CV_32FC1);
+
+  model.kdTree = _search == SEARCH_KD_TREE
+      || (_search == SEARCH_AUTO && model.samples.rows >= KNN_INDEX_MIN_SAMPLES
+          && model.samples.cols <= KNN_INDEX_MAX_DIMENSIONS);
+
+  if (model.kdTree)
+    model.index = std::make_shared<cv::flann::Index>(model.samples, cv::flann::KDTreeIndexParams(KNN_INDEX_TREES));
+  else
+    model.index = std::make_shared<cv::flann::Index>(model.samples, cv::flann::LinearIndexParams());
 }
 
-bool KNNDigitClassifier::save(const std::string& filename) const
+void KNNDigitClassifier::predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const
 {
-  return false;
+  const KNNModel& knnModel = static_cast<const KNNModel&>(model);
+
+  int k = std::min(static_cast<int>(_k), knnModel.samples.rows);
+  if (k == 0)
+    return;
+
+  cv::Mat query = samples;
+  if (! query.isContinuous() || query.type() != CV_32FC1)
+    query.convertTo(query, CV_32FC1);
+
+  cv::Mat indices, distances;
+  knnModel.index->knnSearch(query, indices, distances, k, cv::flann::SearchParams(KNN_INDEX_CHECKS));
+
+  // majority vote of the neighbours like CvKNearest, a tie goes to the smaller
+  // digit, the scores are the shares of the votes
+  for (int i = 0; i < samples.rows; ++i)
+  {
+    Classification& classification = classifications[i];
+    for (int j = 0; j < k; ++j)
+    {
+      int neighbor = indices.at<int>(i, j);
+      if (neighbor < 0 || neighbor >= knnModel.responses.rows)
+        continue;
+
+      int digit = knnModel.responses.at<int>(neighbor, 0);
+      if (digit >= 1 && digit <= NUM_DIGITS)
+        classification.scores[digit - 1] += 1.f;
+    }
+
+    uchar label = static_cast<uchar>(std::max_element(classification.scores, classification.scores + NUM_DIGITS)
+                                     - classification.scores + 1);
+    classification.finish(label);
+  }
 }
 
-void KNNDigitClassifier::create()
+bool KNNDigitClassifier::load(const std::string& filename)
 {
-  _knn = new cv::KNearest;
+  std::shared_ptr<KNNModel> model = std::make_shared<KNNModel>();
+  try
+  {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (! fs.isOpened() || ! readPreprocessing(fs, *model))
+      return false;
+
+    cv::FileNode node = fs["knn"];
+    if (node.empty())
+      return false;
+    node["samples"] >> model->samples;
+    node["responses"] >> model->responses;
+  }
+  catch (...)
+  {
+    return false;
+  }
+
+  if (model->samples.empty() || model->samples.cols != static_cast<int>(inputSize(*model))
+      || model->responses.rows != model->samples.rows)
+    return false;
+
+  model->responses.convertTo(model->responses, CV_32SC1);
+  buildIndex(*model);
+  setModel(model);
+  return true;
 }
 
-void KNNDigitClassifier::cleanup()
+bool KNNDigitClassifier::save(const std::string& filename) const
 {
-  if (_knn) delete _knn;
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return false;
+
+  const KNNModel& knnModel = static_cast<const KNNModel&>(*current);
+  try
+  {
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    if (! fs.isOpened())
+      return false;
+
+    writePreprocessing(fs, knnModel);
+    fs << "knn" << "{" << "samples" << knnModel.samples << "responses" << knnModel.responses << "}";
+    return true;
+  }
+  catch (...)
+  {
+    return false;
+  }
 }
@@ -1,8 +1,55 @@
 #include "../../include/classification/nndigitclassifier.hpp"
+#include "../../include/utils/parallelutils.hpp"
 
-NNDigitClassifier::NNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents)
+#include <algorithm>
+#include <cmath>
+
+#define NN_NODE_NAME "my_nn"
+#define NN_TEMPERATURE_NAME "temperature"
+
+namespace
+{
+  // mean negative log probability of the labels under a softmax of the outputs
+  double negativeLogLikelihood(const cv::Mat& outputs, const cv::Mat& labelMat, double temperature)
+  {
+    double sum = 0.0;
+    for (int row = 0; row < outputs.rows; ++row)
+    {
+      const float *output = outputs.ptr<float>(row);
+      float maxOutput = *std::max_element(output, output + outputs.cols);
+      double partition = 0.0;
+      for (int digit = 0; digit < outputs.cols; ++digit)
+        partition += std::exp((output[digit] - maxOutput) / temperature);
+
+      int label = labelMat.at<int>(row, 0);
+      sum += std::log(partition) - (output[label - 1] - maxOutput) / temperature;
+    }
+
+    return sum / std::max(1, outputs.rows);
+  }
+
+  // golden section search of the temperature on a log scale
+  float fitTemperature(const cv::Mat& outputs, const cv::Mat& labelMat)
+  {
+    const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+    double low = std::log(0.01), high = std::log(10.0);
+    for (int i = 0; i < 60; ++i)
+    {
+      double a = high - ratio * (high - low);
+      double b = low + ratio * (high - low);
+      if (negativeLogLikelihood(outputs, labelMat, std::exp(a)) < negativeLogLikelihood(outputs, labelMat, std::exp(b)))
+        high = b;
+      else
+        low = a;
+    }
+
+    return static_cast<float>(std::exp(0.5 * (low + high)));
+  }
+}
+
+NNDigitClassifier::NNDigitClassifier(const DigitExtractor& extractor, size_t sampleWidth, size_t pcaComponents, bool quantized)
   : DigitClassifier(extractor, sampleWidth, pcaComponents),
-    _nn(nullptr)
+    _quantized(quantized)
 {
 }
 
@@ -12,50 +59,218 @@ NNDigitClassifier::~NNDigitClassifier()
 
 void NNDigitClassifier::train(const std::vector<cv::Mat>* trainingImages)
 {
+  std::shared_ptr<NNModel> model = std::make_shared<NNModel>();
+
+  cv::Mat trainingMat, labelMat;
+  prepareTrainingMat(trainingImages, trainingMat, labelMat, *model);
+
+  // the input layer takes the samples after PCA
   cv::Mat layers(1, 3, CV_32SC1);
-  layers.at<int>(0,0) = getSampleWidth() * getSampleWidth();
+  layers.at<int>(0,0) = trainingMat.cols;
   layers.at<int>(0,1) = 35;
   layers.at<int>(0,2) = 9;
-  _nn = new CvANN_MLP(layers);
+  model->nn.create(layers);
 
-  cv::Mat trainingMat, labelMat;
-  prepareTrainingMat(trainingImages, trainingMat, labelMat);
+  model->nn.train(trainingMat, targets(labelMat), cv::Mat());
+  calibrate(trainingMat, labelMat, layers, *model);
+  model->nn.exportTo(model->quantized);
+  model->quantized.setTemperature(model->temperature);
+  setModel(model);
+}
 
+cv::Mat NNDigitClassifier::targets(const cv::Mat& labelMat)
+{
   cv::Mat outputVector(labelMat.rows, 9, CV_32FC1);
   for (size_t row = 0; row < labelMat.rows; ++row)
   {
     for (size_t digit = 1; digit <= 9; ++digit)
     {
-      if (digit == labelMat.at<float>(row, 0))
+      if (digit == labelMat.at<int>(row, 0))
         outputVector.at<float>(row, digit-1) = 1.f;
       else
-        outputVector.at<int>(row, digit-1) = 0.f;
+        outputVector.at<float>(row, digit-1) = 0.f;
     }
   }
 
-  _nn->train(trainingMat, outputVector, cv::Mat());
+  return outputVector;
 }
 
-uchar NNDigitClassifier::classify(const cv::Mat& image)
+void NNDigitClassifier::calibrate(const cv::Mat& trainingMat, const cv::Mat& labelMat, const cv::Mat& layers,
+                                  NNModel& model) const
 {
-  if (! _nn)
-    return NO_DIGIT_FOUND;
+  // image i of each digit goes to fold i % NN_CALIBRATION_FOLDS, so every fold holds all digits
+  std::vector<int> folds(trainingMat.rows);
+  std::vector<int> counts(NUM_DIGITS + 1, 0);
+  for (int row = 0; row < trainingMat.rows; ++row)
+  {
+    int label = labelMat.at<int>(row, 0);
+    folds[row] = label >= 1 && label <= NUM_DIGITS ? counts[label]++ % NN_CALIBRATION_FOLDS : 0;
+  }
 
-  cv::Mat prepared = prepareDigitMat(image);
-  cv::Mat response;
-  _nn->predict(prepared, response);
-  cv::Point maxDigit;
-  cv::minMaxLoc(response, nullptr, nullptr, nullptr, &maxDigit);
+  cv::Mat outputs(trainingMat.rows, layers.at<int>(0, 2), CV_32FC1);
+  for (int fold = 0; fold < NN_CALIBRATION_FOLDS; ++fold)
+  {
+    cv::Mat foldTraining, foldLabels, heldOut;
+    std::vector<int> heldOutRows;
+    for (int row = 0; row < trainingMat.rows; ++row)
+    {
+      if (folds[row] == fold)
+      {
+        heldOut.push_back(trainingMat.row(row));
+        heldOutRows.push_back(row);
+      }
+      else
+      {
+        foldTraining.push_back(trainingMat.row(row));
+        foldLabels.push_back(labelMat.row(row));
+      }
+    }
 
-  return static_cast<uchar>(maxDigit.x + 1);
+    // too few samples for a fold leave the outputs uncalibrated
+    if (heldOut.empty() || foldTraining.empty())
+      return;
+
+    CvANN_MLP nn(layers);
+    nn.train(foldTraining, targets(foldLabels), cv::Mat());
+
+    cv::Mat foldOutputs;
+    nn.predict(heldOut, foldOutputs);
+    for (size_t i = 0; i < heldOutRows.size(); ++i)
+      foldOutputs.row(i).copyTo(outputs.row(heldOutRows[i]));
+  }
+
+  model.temperature = fitTemperature(outputs, labelMat);
+}
+
+void NNDigitClassifier::predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const
+{
+  const NNModel& nnModel = static_cast<const NNModel&>(model);
+  if (_quantized && ! nnModel.quantized.empty())
+  {
+    nnModel.quantized.predict(samples, classifications);
+    return;
+  }
+
+  const CvANN_MLP& nn = nnModel.nn;
+
+  // the MLP predicts sequentially, so the rows are spread over the cores
+  ParallelUtils::parallelFor(samples.rows, [&](int i)
+  {
+    static thread_local cv::Mat response;
+    nn.predict(samples.row(i), response);
+    QuantizedMLP::classify(response.ptr<float>(0), response.cols, nnModel.temperature, classifications[i]);
+  });
 }
 
 bool NNDigitClassifier::load(const std::string &filename)
 {
-  return false;
+  std::shared_ptr<NNModel> model = std::make_shared<NNModel>();
+  try
+  {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (! fs.isOpened() || ! readPreprocessing(fs, *model))
+      return false;
+
+    cv::FileNode node = fs[NN_NODE_NAME];
+    if (node.empty())
+      return false;
+    model->nn.read(*fs, *node);
+
+    // models saved before the calibration keep the clipped outputs
+    cv::FileNode temperature = fs[NN_TEMPERATURE_NAME];
+    if (! temperature.empty())
+      model->temperature = std::max(0.f, static_cast<float>(temperature));
+  }
+  catch (...)
+  {
+    return false;
+  }
+
+  const CvMat *layerSizes = model->nn.get_layer_sizes();
+  if (! layerSizes || layerSizes->cols < 2 || layerSizes->data.i[0] != static_cast<int>(inputSize(*model)))
+    return false;
+
+  model->nn.exportTo(model->quantized);
+  model->quantized.setTemperature(model->temperature);
+  setModel(model);
+  return true;
 }
 
 bool NNDigitClassifier::save(const std::string &filename) const
 {
-  return false;
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return false;
+
+  try
+  {
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    if (! fs.isOpened())
+      return false;
+
+    writePreprocessing(fs, *current);
+    const NNModel& nnModel = static_cast<const NNModel&>(*current);
+    nnModel.nn.write(*fs, NN_NODE_NAME);
+    fs << NN_TEMPERATURE_NAME << nnModel.temperature;
+    return true;
+  }
+  catch (...)
+  {
+    return false;
+  }
+}
+
+void NNDigitClassifier::setQuantized(bool quantized)
+{
+  _quantized = quantized;
+}
+
+bool NNDigitClassifier::isQuantized() const
+{
+  return _quantized;
+}
+
+bool NNDigitClassifier::ExportableMLP::exportTo(QuantizedMLP& mlp) const
+{
+  mlp.clear();
+  if (! layer_sizes || ! weights || activ_func != SIGMOID_SYM)
+    return false;
+
+  // weights[0] scales the inputs, weights[1..n-1] hold the layers as
+  // inputs x outputs matrices followed by the biases and weights[n] scales the outputs
+  int layerCount = layer_sizes->cols;
+
+  // the input scaling stays a float step: folded into the first layer it would
+  // spread the weights of one neuron over a range its int8 steps cannot resolve
+  int sampleSize = layer_sizes->data.i[0];
+  std::vector<float> inputScale(sampleSize), inputShift(sampleSize);
+  for (int i = 0; i < sampleSize; ++i)
+  {
+    inputScale[i] = weights[0][2 * i];
+    inputShift[i] = weights[0][2 * i + 1];
+  }
+  mlp.setInputScale(inputScale, inputShift);
+
+  for (int l = 1; l < layerCount; ++l)
+  {
+    int inputs = layer_sizes->data.i[l - 1];
+    int outputs = layer_sizes->data.i[l];
+    const double *w = weights[l];
+
+    cv::Mat layerWeights = cv::Mat(inputs, outputs, CV_64FC1, const_cast<double*>(w)).t();
+    std::vector<float> bias(w + inputs * outputs, w + inputs * outputs + outputs);
+    mlp.addLayer(layerWeights, bias);
+  }
+
+  int outputs = layer_sizes->data.i[layerCount - 1];
+  std::vector<float> scale(outputs), shift(outputs);
+  for (int o = 0; o < outputs; ++o)
+  {
+    scale[o] = weights[layerCount][2 * o];
+    shift[o] = weights[layerCount][2 * o + 1];
+  }
+  mlp.setOutputScale(scale, shift);
+  mlp.setActivation(f_param1, f_param2);
+
+  return true;
 }
@@ -0,0 +1,192 @@
+#include "../../include/classification/quantizedmlp.hpp"
+#include "../../include/utils/cpufeatures.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef CPU_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+#define QUANTIZEDMLP_BLOCK 16
+
+namespace
+{
+#ifdef CPU_AVX2_KERNELS
+  const bool useAVX2 = CPUFeatures::hasAVX2();
+
+  CPU_TARGET_AVX2 int32_t dotAVX2(const int8_t* a, const int8_t* b, size_t n)
+  {
+    // widened to 16 bits, pairs of products are summed into 32 bits
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += QUANTIZEDMLP_BLOCK)
+    {
+      __m256i x = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+      __m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    return _mm_cvtsi128_si32(sum128);
+  }
+#endif
+
+  // n is a multiple of QUANTIZEDMLP_BLOCK
+  inline int32_t dot(const int8_t* a, const int8_t* b, size_t n)
+  {
+#ifdef CPU_AVX2_KERNELS
+    if (useAVX2)
+      return dotAVX2(a, b, n);
+#endif
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+      sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+  }
+
+  // symmetric quantization of n values to int8, returns the scale of one step
+  float quantize(const float* values, size_t n, int8_t* quantized)
+  {
+    float max = 0.f;
+    for (size_t i = 0; i < n; ++i)
+      max = std::max(max, std::fabs(values[i]));
+
+    float scale = max > 0.f ? max / 127.f : 1.f;
+    for (size_t i = 0; i < n; ++i)
+      quantized[i] = static_cast<int8_t>(std::lround(values[i] / scale));
+
+    return scale;
+  }
+}
+
+QuantizedMLP::QuantizedMLP()
+{
+  clear();
+}
+
+void QuantizedMLP::clear()
+{
+  _layers.clear();
+  _alpha = 0.f;
+  _beta = 0.f;
+  _inputScale.clear();
+  _inputShift.clear();
+  _outputScale.clear();
+  _outputShift.clear();
+  _temperature = 0.f;
+}
+
+bool QuantizedMLP::empty() const
+{
+  return _layers.empty();
+}
+
+size_t QuantizedMLP::inputs() const
+{
+  return _layers.empty() ? 0 : _layers.front().inputs;
+}
+
+void QuantizedMLP::setActivation(double alpha, double beta)
+{
+  _alpha = static_cast<float>(alpha);
+  _beta = static_cast<float>(beta);
+}
+
+void QuantizedMLP::addLayer(const cv::Mat& weights, const std::vector<float>& bias)
+{
+  cv::Mat floatWeights;
+  weights.convertTo(floatWeights, CV_32FC1);
+
+  Layer layer;
+  layer.outputs = floatWeights.rows;
+  layer.inputs = floatWeights.cols;
+  layer.stride = (layer.inputs + QUANTIZEDMLP_BLOCK - 1) / QUANTIZEDMLP_BLOCK * QUANTIZEDMLP_BLOCK;
+  layer.bias = bias;
+
+  // zero padded, so the padding adds nothing to dot products
+  layer.scales.resize(layer.outputs);
+  layer.weights.assign(layer.outputs * layer.stride, 0);
+  for (size_t o = 0; o < layer.outputs; ++o)
+    layer.scales[o] = quantize(floatWeights.ptr<float>(o), layer.inputs, &layer.weights[o * layer.stride]);
+
+  _layers.push_back(layer);
+}
+
+void QuantizedMLP::setInputScale(const std::vector<float>& scale, const std::vector<float>& shift)
+{
+  _inputScale = scale;
+  _inputShift = shift;
+}
+
+void QuantizedMLP::setOutputScale(const std::vector<float>& scale, const std::vector<float>& shift)
+{
+  _outputScale = scale;
+  _outputShift = shift;
+}
+
+void QuantizedMLP::setTemperature(float temperature)
+{
+  _temperature = temperature;
+}
+
+void QuantizedMLP::forward(const float* sample, std::vector<float>& outputs) const
+{
+  static thread_local std::vector<float> activations;
+  static thread_local std::vector<int8_t> quantized;
+
+  activations.assign(sample, sample + inputs());
+  for (size_t i = 0; i < activations.size() && i < _inputScale.size(); ++i)
+    activations[i] = activations[i] * _inputScale[i] + _inputShift[i];
+
+  for (const Layer& layer : _layers)
+  {
+    quantized.assign(layer.stride, 0);
+    float inputScale = quantize(&activations[0], layer.inputs, &quantized[0]);
+
+    outputs.resize(layer.outputs);
+    for (size_t o = 0; o < layer.outputs; ++o)
+    {
+      float x = dot(&layer.weights[o * layer.stride], &quantized[0], layer.stride) * inputScale * layer.scales[o]
+              + layer.bias[o];
+      float e = std::exp(-_alpha * x);
+      outputs[o] = _beta * (1.f - e) / (1.f + e);
+    }
+
+    activations.swap(outputs);
+  }
+
+  outputs.swap(activations);
+  for (size_t o = 0; o < outputs.size() && o < _outputScale.size(); ++o)
+    outputs[o] = outputs[o] * _outputScale[o] + _outputShift[o];
+}
+
+void QuantizedMLP::predict(const cv::Mat& samples, std::vector<Classification>& classifications) const
+{
+  // a few microseconds for a whole grid, so there is nothing to gain from more threads
+  static thread_local std::vector<float> outputs;
+  for (int i = 0; i < samples.rows; ++i)
+  {
+    forward(samples.ptr<float>(i), outputs);
+    classify(&outputs[0], outputs.size(), _temperature, classifications[i]);
+  }
+}
+
+void QuantizedMLP::classify(const float *outputs, size_t count, float temperature, Classification& classification)
+{
+  count = std::min<size_t>(count, NUM_DIGITS);
+  size_t best = 0;
+  for (size_t digit = 1; digit < count; ++digit)
+    if (outputs[digit] > outputs[best])
+      best = digit;
+
+  for (size_t digit = 0; digit < count; ++digit)
+  {
+    if (temperature > 0.f)
+      classification.scores[digit] = std::exp((outputs[digit] - outputs[best]) / temperature);
+    else
+      classification.scores[digit] = std::max(0.f, outputs[digit]);
+  }
+  classification.finish(static_cast<uchar>(best + 1));
+}
@@ -0,0 +1,622 @@
+#include "../../include/classification/rbfsvmengine.hpp"
+#include "../../include/utils/cpufeatures.hpp"
+#include "../../include/utils/parallelutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifdef CPU_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+#define RBFSVM_ALIGNMENT 32
+#define RBFSVM_ALIGN_FLOATS (RBFSVM_ALIGNMENT / sizeof(float))
+// pairwise probabilities are kept this far from 0 and 1, like libsvm does
+#define RBFSVM_MIN_PAIRWISE_PROBABILITY 1e-7
+
+namespace
+{
+  // the aligned start of storage, nullptr if it is empty
+  float* alignedData(std::vector<float>& storage)
+  {
+    if (storage.empty())
+      return nullptr;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(&storage[0]);
+    size_t offset = (RBFSVM_ALIGNMENT - address % RBFSVM_ALIGNMENT) % RBFSVM_ALIGNMENT;
+    return &storage[0] + offset / sizeof(float);
+  }
+
+  float* allocateAligned(std::vector<float>& storage, size_t size)
+  {
+    storage.assign(size + RBFSVM_ALIGN_FLOATS, 0.f);
+    return alignedData(storage);
+  }
+
+#ifdef CPU_AVX2_KERNELS
+  const bool useAVX2 = CPUFeatures::hasAVX2();
+
+  CPU_TARGET_AVX2 float dotAVX2(const float* a, const float* b, size_t n)
+  {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+      sum0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i), sum0);
+      sum1 = _mm256_fmadd_ps(_mm256_load_ps(a + i + 8), _mm256_load_ps(b + i + 8), sum1);
+    }
+    if (i < n)
+      sum0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i), sum0);
+
+    sum0 = _mm256_add_ps(sum0, sum1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    return _mm_cvtss_f32(sum);
+  }
+
+  // Cephes' expf: exp(x) = 2^n * exp(r) with |r| <= ln(2)/2 and a polynomial for exp(r)
+  CPU_TARGET_AVX2 inline __m256 exp256(__m256 x)
+  {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+    p = _mm256_add_ps(p, _mm256_set1_ps(1.f));
+
+    __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+  }
+
+  // the multiple of 8 values in front, the rest is left to the caller
+  CPU_TARGET_AVX2 size_t expInPlaceAVX2(float* values, size_t n)
+  {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+      _mm256_storeu_ps(values + i, exp256(_mm256_loadu_ps(values + i)));
+    return i;
+  }
+#endif
+
+  // a and b are aligned and n is a multiple of 8
+  inline float dot(const float* a, const float* b, size_t n)
+  {
+#ifdef CPU_AVX2_KERNELS
+    if (useAVX2)
+      return dotAVX2(a, b, n);
+#endif
+    float sum = 0.f;
+    for (size_t i = 0; i < n; ++i)
+      sum += a[i] * b[i];
+    return sum;
+  }
+
+  void expInPlace(float* values, size_t n)
+  {
+    size_t i = 0;
+#ifdef CPU_AVX2_KERNELS
+    if (useAVX2)
+      i = expInPlaceAVX2(values, n);
+#endif
+    for (; i < n; ++i)
+      values[i] = std::exp(values[i]);
+  }
+
+  RBFSVMEngine::Sigmoid defaultSigmoid()
+  {
+    RBFSVMEngine::Sigmoid sigmoid;
+    sigmoid.a = -SVM_DECISION_SLOPE;
+    sigmoid.b = 0.0;
+    return sigmoid;
+  }
+
+  // Platt scaling, fitted with the Newton method of Lin, Lin and Weng like
+  // libsvm's sigmoid_train; first tells which values belong to the first class
+  RBFSVMEngine::Sigmoid fitSigmoid(const std::vector<double>& values, const std::vector<bool>& first)
+  {
+    const int maxIterations = 100;
+    const double minStep = 1e-10;
+    const double sigma = 1e-12;
+    const double eps = 1e-5;
+
+    size_t n = values.size();
+    double prior1 = std::count(std::begin(first), std::end(first), true);
+    double prior0 = n - prior1;
+
+    // targets slightly away from 0 and 1 keep the fit from overshooting on separable data
+    double hiTarget = (prior1 + 1.0) / (prior1 + 2.0);
+    double loTarget = 1.0 / (prior0 + 2.0);
+    std::vector<double> targets(n);
+    for (size_t i = 0; i < n; ++i)
+      targets[i] = first[i] ? hiTarget : loTarget;
+
+    auto objective = [&](double a, double b)
+    {
+      double f = 0.0;
+      for (size_t i = 0; i < n; ++i)
+      {
+        double fApB = values[i] * a + b;
+        if (fApB >= 0.0)
+          f += targets[i] * fApB + std::log1p(std::exp(-fApB));
+        else
+          f += (targets[i] - 1.0) * fApB + std::log1p(std::exp(fApB));
+      }
+      return f;
+    };
+
+    RBFSVMEngine::Sigmoid sigmoid;
+    sigmoid.a = 0.0;
+    sigmoid.b = std::log((prior0 + 1.0) / (prior1 + 1.0));
+    double f = objective(sigmoid.a, sigmoid.b);
+
+    for (int iteration = 0; iteration < maxIterations; ++iteration)
+    {
+      double h11 = sigma, h22 = sigma, h21 = 0.0, g1 = 0.0, g2 = 0.0;
+      for (size_t i = 0; i < n; ++i)
+      {
+        double fApB = values[i] * sigmoid.a + sigmoid.b;
+        double p, q;
+        if (fApB >= 0.0)
+        {
+          p = std::exp(-fApB) / (1.0 + std::exp(-fApB));
+          q = 1.0 / (1.0 + std::exp(-fApB));
+        }
+        else
+        {
+          p = 1.0 / (1.0 + std::exp(fApB));
+          q = std::exp(fApB) / (1.0 + std::exp(fApB));
+        }
+
+        double d2 = p * q;
+        h11 += values[i] * values[i] * d2;
+        h22 += d2;
+        h21 += values[i] * d2;
+
+        double d1 = targets[i] - p;
+        g1 += values[i] * d1;
+        g2 += d1;
+      }
+
+      if (std::fabs(g1) < eps && std::fabs(g2) < eps)
+        break;
+
+      double det = h11 * h22 - h21 * h21;
+      double dA = -(h22 * g1 - h21 * g2) / det;
+      double dB = -(-h21 * g1 + h11 * g2) / det;
+      double gd = g1 * dA + g2 * dB;
+
+      // backtracking line search along the Newton direction
+      double step = 1.0;
+      for (; step >= minStep; step /= 2.0)
+      {
+        double a = sigmoid.a + step * dA;
+        double b = sigmoid.b + step * dB;
+        double newF = objective(a, b);
+        if (newF < f + 0.0001 * step * gd)
+        {
+          sigmoid.a = a;
+          sigmoid.b = b;
+          f = newF;
+          break;
+        }
+      }
+
+      if (step < minStep)
+        break;
+    }
+
+    return sigmoid;
+  }
+
+  // The second method of Wu, Lin and Weng, as in libsvm's multiclass_probability:
+  // the distribution p over k classes minimizing sum_i sum_j!=i (r_ji p_i - r_ij p_j)^2,
+  // where r holds the probability r_ij of i against j at r[i * k + j].
+  void couple(const std::vector<double>& r, size_t k, std::vector<double>& p)
+  {
+    static thread_local std::vector<double> Q, Qp;
+    Q.assign(k * k, 0.0);
+    Qp.assign(k, 0.0);
+    p.assign(k, 1.0 / k);
+
+    for (size_t t = 0; t < k; ++t)
+    {
+      for (size_t j = 0; j < k; ++j)
+      {
+        if (j == t)
+          continue;
+        Q[t * k + t] += r[j * k + t] * r[j * k + t];
+        Q[t * k + j] = -r[j * k + t] * r[t * k + j];
+      }
+    }
+
+    size_t maxIterations = std::max<size_t>(100, k);
+    double eps = 0.005 / k;
+    for (size_t iteration = 0; iteration < maxIterations; ++iteration)
+    {
+      // Qp and pQp are recomputed every iteration to limit rounding errors
+      double pQp = 0.0;
+      for (size_t t = 0; t < k; ++t)
+      {
+        Qp[t] = 0.0;
+        for (size_t j = 0; j < k; ++j)
+          Qp[t] += Q[t * k + j] * p[j];
+        pQp += p[t] * Qp[t];
+      }
+
+      double maxError = 0.0;
+      for (size_t t = 0; t < k; ++t)
+        maxError = std::max(maxError, std::fabs(Qp[t] - pQp));
+      if (maxError < eps)
+        break;
+
+      for (size_t t = 0; t < k; ++t)
+      {
+        double diff = (-Qp[t] + pQp) / Q[t * k + t];
+        p[t] += diff;
+        pQp = (pQp + diff * (diff * Q[t * k + t] + 2.0 * Qp[t])) / (1.0 + diff) / (1.0 + diff);
+        for (size_t j = 0; j < k; ++j)
+        {
+          Qp[j] = (Qp[j] + diff * Q[t * k + j]) / (1.0 + diff);
+          p[j] /= 1.0 + diff;
+        }
+      }
+    }
+  }
+}
+
+RBFSVMEngine::RBFSVMEngine()
+{
+  clear();
+}
+
+void RBFSVMEngine::clear()
+{
+  _count = 0;
+  _varCount = 0;
+  _stride = 0;
+  _gamma = 0.f;
+  _supportVectorStorage.clear();
+  _squaredNormStorage.clear();
+  _labelStorage.clear();
+  _decisionStorage.clear();
+  _svIndexStorage.clear();
+  _alphaStorage.clear();
+  _sigmoidStorage.clear();
+  _file.reset();
+  useStorage();
+}
+
+void RBFSVMEngine::useStorage()
+{
+  _classCount = _labelStorage.size();
+  _coefficientCount = _svIndexStorage.size();
+
+  _supportVectors = alignedData(_supportVectorStorage);
+  _squaredNorms = _squaredNormStorage.empty() ? nullptr : &_squaredNormStorage[0];
+  _labels = _labelStorage.empty() ? nullptr : &_labelStorage[0];
+  _decisions = _decisionStorage.empty() ? nullptr : &_decisionStorage[0];
+  _svIndices = _svIndexStorage.empty() ? nullptr : &_svIndexStorage[0];
+  _alphas = _alphaStorage.empty() ? nullptr : &_alphaStorage[0];
+  _sigmoids = _sigmoidStorage.empty() ? nullptr : &_sigmoidStorage[0];
+}
+
+bool RBFSVMEngine::empty() const
+{
+  return _count == 0 || _classCount < 2 || ! _decisions;
+}
+
+size_t RBFSVMEngine::supportVectorCount() const
+{
+  return _count;
+}
+
+size_t RBFSVMEngine::decisionCount() const
+{
+  return _classCount * (_classCount - 1) / 2;
+}
+
+void RBFSVMEngine::setSupportVectors(const float* const* supportVectors, int count, int varCount, double gamma)
+{
+  _count = count;
+  _varCount = varCount;
+  _stride = (varCount + RBFSVM_ALIGN_FLOATS - 1) / RBFSVM_ALIGN_FLOATS * RBFSVM_ALIGN_FLOATS;
+  _gamma = static_cast<float>(gamma);
+
+  // zero padded, so the padding adds nothing to dot products
+  float *aligned = allocateAligned(_supportVectorStorage, _count * _stride);
+  _squaredNormStorage.resize(_count);
+  for (size_t k = 0; k < _count; ++k)
+  {
+    float *row = aligned + k * _stride;
+    std::copy(supportVectors[k], supportVectors[k] + _varCount, row);
+    _squaredNormStorage[k] = dot(row, row, _stride);
+  }
+
+  useStorage();
+}
+
+void RBFSVMEngine::addClass(int label)
+{
+  _labelStorage.push_back(label);
+  useStorage();
+}
+
+void RBFSVMEngine::addDecision(double rho, const int* svIndex, const double* alpha, int count)
+{
+  Decision decision;
+  decision.rho = rho;
+  decision.begin = _svIndexStorage.size();
+  decision.end = decision.begin + count;
+  _decisionStorage.push_back(decision);
+
+  _svIndexStorage.insert(_svIndexStorage.end(), svIndex, svIndex + count);
+  _alphaStorage.insert(_alphaStorage.end(), alpha, alpha + count);
+  _sigmoidStorage.push_back(defaultSigmoid());
+  useStorage();
+}
+
+void RBFSVMEngine::calibrate(const cv::Mat& values, const cv::Mat& labels)
+{
+  size_t decisionCount = this->decisionCount();
+  if (empty() || values.type() != CV_64FC1 || static_cast<size_t>(values.cols) != decisionCount
+      || labels.type() != CV_32SC1 || labels.total() != static_cast<size_t>(values.rows))
+    return;
+
+  // the sigmoids may point into a mapped file
+  std::vector<Sigmoid> sigmoids(_sigmoids, _sigmoids + decisionCount);
+
+  std::vector<double> pairValues;
+  std::vector<bool> first;
+  size_t d = 0;
+  for (size_t i = 0; i < _classCount; ++i)
+  {
+    for (size_t j = i + 1; j < _classCount; ++j, ++d)
+    {
+      // only the samples of the two classes tell how well the decision separates them
+      pairValues.clear();
+      first.clear();
+      for (int row = 0; row < values.rows; ++row)
+      {
+        int label = labels.ptr<int>()[row];
+        if (label != _labels[i] && label != _labels[j])
+          continue;
+
+        pairValues.push_back(values.at<double>(row, d));
+        first.push_back(label == _labels[i]);
+      }
+
+      if (! pairValues.empty())
+        sigmoids[d] = fitSigmoid(pairValues, first);
+    }
+  }
+
+  setSigmoids(sigmoids);
+}
+
+std::vector<RBFSVMEngine::Sigmoid> RBFSVMEngine::sigmoids() const
+{
+  return _sigmoids ? std::vector<Sigmoid>(_sigmoids, _sigmoids + decisionCount()) : std::vector<Sigmoid>();
+}
+
+bool RBFSVMEngine::setSigmoids(const std::vector<Sigmoid>& sigmoids)
+{
+  if (empty() || sigmoids.size() != decisionCount())
+    return false;
+
+  _sigmoidStorage = sigmoids;
+  _sigmoids = &_sigmoidStorage[0];
+  return true;
+}
+
+void RBFSVMEngine::write(BinaryModelWriter& writer) const
+{
+  BinaryModelHeader& header = writer.header();
+  header.type = BinaryModelHeader::TYPE_RBF_SVM;
+  header.varCount = _varCount;
+  header.stride = _stride;
+  header.svCount = _count;
+  header.classCount = _classCount;
+  header.coefficientCount = _coefficientCount;
+  header.gamma = _gamma;
+
+  size_t decisionCount = _classCount * (_classCount - 1) / 2;
+  writer.setSection(BinaryModelHeader::SECTION_CLASS_LABELS, _labels, _classCount * sizeof(int32_t));
+  writer.setSection(BinaryModelHeader::SECTION_DECISIONS, _decisions, decisionCount * sizeof(Decision));
+  writer.setSection(BinaryModelHeader::SECTION_SV_INDICES, _svIndices, _coefficientCount * sizeof(int32_t));
+  writer.setSection(BinaryModelHeader::SECTION_ALPHAS, _alphas, _coefficientCount * sizeof(double));
+  writer.setSection(BinaryModelHeader::SECTION_SQUARED_NORMS, _squaredNorms, _count * sizeof(float));
+  writer.setSection(BinaryModelHeader::SECTION_SUPPORT_VECTORS, _supportVectors, _count * _stride * sizeof(float));
+  writer.setSection(BinaryModelHeader::SECTION_SIGMOIDS, _sigmoids, decisionCount * sizeof(Sigmoid));
+}
+
+bool RBFSVMEngine::read(const BinaryModelReader& reader)
+{
+  clear();
+
+  const BinaryModelHeader& header = reader.header();
+  if (header.type != BinaryModelHeader::TYPE_RBF_SVM || header.classCount < 2
+      || header.stride % RBFSVM_ALIGN_FLOATS != 0 || header.stride < header.varCount)
+    return false;
+
+  size_t decisionCount = header.classCount * (header.classCount - 1) / 2;
+  const float *supportVectors = reader.section<float>(BinaryModelHeader::SECTION_SUPPORT_VECTORS, header.svCount * header.stride);
+  const float *squaredNorms = reader.section<float>(BinaryModelHeader::SECTION_SQUARED_NORMS, header.svCount);
+  const int32_t *labels = reader.section<int32_t>(BinaryModelHeader::SECTION_CLASS_LABELS, header.classCount);
+  const Decision *decisions = reader.section<Decision>(BinaryModelHeader::SECTION_DECISIONS, decisionCount);
+  const int32_t *svIndices = reader.section<int32_t>(BinaryModelHeader::SECTION_SV_INDICES, header.coefficientCount);
+  const double *alphas = reader.section<double>(BinaryModelHeader::SECTION_ALPHAS, header.coefficientCount);
+  // files written before the sigmoids were fitted have none
+  const Sigmoid *sigmoids = reader.section<Sigmoid>(BinaryModelHeader::SECTION_SIGMOIDS, decisionCount);
+  if (! supportVectors || ! squaredNorms || ! labels || ! decisions || ! svIndices || ! alphas
+      || (! sigmoids && header.sizes[BinaryModelHeader::SECTION_SIGMOIDS] != 0))
+    return false;
+
+  // the kernel loop indexes with these without further checks
+  for (size_t i = 0; i < decisionCount; ++i)
+    if (decisions[i].begin > decisions[i].end || decisions[i].end > header.coefficientCount)
+      return false;
+  for (size_t k = 0; k < header.coefficientCount; ++k)
+    if (svIndices[k] < 0 || static_cast<uint32_t>(svIndices[k]) >= header.svCount)
+      return false;
+
+  _count = header.svCount;
+  _varCount = header.varCount;
+  _stride = header.stride;
+  _gamma = header.gamma;
+  _classCount = header.classCount;
+  _coefficientCount = header.coefficientCount;
+
+  _supportVectors = supportVectors;
+  _squaredNorms = squaredNorms;
+  _labels = labels;
+  _decisions = decisions;
+  _svIndices = svIndices;
+  _alphas = alphas;
+  _file = reader.file();
+
+  if (sigmoids)
+  {
+    _sigmoids = sigmoids;
+  }
+  else
+  {
+    _sigmoidStorage.assign(decisionCount, defaultSigmoid());
+    _sigmoids = &_sigmoidStorage[0];
+  }
+
+  return true;
+}
+
+void RBFSVMEngine::predict(const cv::Mat& samples, std::vector<Classification>& classifications) const
+{
+  int batches = (samples.rows + SVM_BATCH_SIZE - 1) / SVM_BATCH_SIZE;
+  ParallelUtils::parallelFor(batches, [&](int batch)
+  {
+    int first = batch * SVM_BATCH_SIZE;
+    int count = std::min(SVM_BATCH_SIZE, samples.rows - first);
+
+    static thread_local std::vector<float> kernels;
+    static thread_local std::vector<double> values;
+    kernels.resize(count * _count);
+    values.resize(decisionCount());
+    computeKernels(samples, first, count, &kernels[0]);
+
+    for (int i = 0; i < count; ++i)
+    {
+      decide(&kernels[i * _count], &values[0]);
+      score(&values[0], classifications[first + i]);
+    }
+  });
+}
+
+void RBFSVMEngine::decisionValues(const cv::Mat& samples, cv::Mat& values) const
+{
+  values.create(samples.rows, decisionCount(), CV_64FC1);
+
+  int batches = (samples.rows + SVM_BATCH_SIZE - 1) / SVM_BATCH_SIZE;
+  ParallelUtils::parallelFor(batches, [&](int batch)
+  {
+    int first = batch * SVM_BATCH_SIZE;
+    int count = std::min(SVM_BATCH_SIZE, samples.rows - first);
+
+    static thread_local std::vector<float> kernels;
+    kernels.resize(count * _count);
+    computeKernels(samples, first, count, &kernels[0]);
+
+    for (int i = 0; i < count; ++i)
+      decide(&kernels[i * _count], values.ptr<double>(first + i));
+  });
+}
+
+void RBFSVMEngine::computeKernels(const cv::Mat& samples, int first, int count, float* kernels) const
+{
+  // the samples padded like the support vectors
+  static thread_local std::vector<float> storage;
+  float *batch = allocateAligned(storage, count * _stride);
+  float squaredNorms[SVM_BATCH_SIZE];
+  for (int i = 0; i < count; ++i)
+  {
+    const float *sample = samples.ptr<float>(first + i);
+    float *row = batch + i * _stride;
+    std::copy(sample, sample + _varCount, row);
+    squaredNorms[i] = dot(row, row, _stride);
+  }
+
+  // |x - s|^2 = |x|^2 + |s|^2 - 2 x.s, each support vector is loaded once for the batch
+  for (size_t k = 0; k < _count; ++k)
+  {
+    const float *supportVector = _supportVectors + k * _stride;
+    for (int i = 0; i < count; ++i)
+    {
+      float distance = squaredNorms[i] + _squaredNorms[k] - 2.f * dot(batch + i * _stride, supportVector, _stride);
+      kernels[i * _count + k] = -_gamma * std::max(distance, 0.f);
+    }
+  }
+
+  expInPlace(kernels, count * _count);
+}
+
+void RBFSVMEngine::decide(const float* kernel, double* values) const
+{
+  size_t decisionCount = this->decisionCount();
+  const Decision *decision = _decisions;
+  for (size_t d = 0; d < decisionCount; ++d, ++decision)
+  {
+    double sum = -decision->rho;
+    for (size_t k = decision->begin; k < decision->end; ++k)
+      sum += _alphas[k] * kernel[_svIndices[k]];
+    values[d] = sum;
+  }
+}
+
+void RBFSVMEngine::score(const double* values, Classification& classification) const
+{
+  size_t classCount = _classCount;
+  static thread_local std::vector<int> votes;
+  static thread_local std::vector<double> pairwise;
+  static thread_local std::vector<double> probabilities;
+  votes.assign(classCount, 0);
+  pairwise.assign(classCount * classCount, 0.0);
+
+  size_t d = 0;
+  for (size_t i = 0; i < classCount; ++i)
+  {
+    for (size_t j = i + 1; j < classCount; ++j, ++d)
+    {
+      ++votes[values[d] > 0 ? i : j];
+
+      // the sigmoid of the decision value estimates the probability of i against j
+      double p = 1.0 / (1.0 + std::exp(_sigmoids[d].a * values[d] + _sigmoids[d].b));
+      p = std::min(std::max(p, RBFSVM_MIN_PAIRWISE_PROBABILITY), 1.0 - RBFSVM_MIN_PAIRWISE_PROBABILITY);
+      pairwise[i * classCount + j] = p;
+      pairwise[j * classCount + i] = 1.0 - p;
+    }
+  }
+
+  couple(pairwise, classCount, probabilities);
+
+  size_t winner = 0;
+  for (size_t i = 1; i < classCount; ++i)
+    if (votes[i] > votes[winner])
+      winner = i;
+
+  for (size_t i = 0; i < classCount; ++i)
+  {
+    int digit = _labels[i];
+    if (digit >= 1 && digit <= NUM_DIGITS)
+      classification.scores[digit - 1] = static_cast<float>(probabilities[i]);
+  }
+  classification.finish(static_cast<uchar>(_labels[winner]));
+}
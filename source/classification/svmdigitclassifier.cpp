@@ -1,66 +1,245 @@
 #include "../../include/classification/svmdigitclassifier.hpp"
+#include "../../include/utils/parallelutils.hpp"
+
+// the name CvSVM::save gives the model, used by the shipped classifiers
+#define SVM_NODE_NAME "my_svm"
+#define SIGMOIDS_NODE_NAME "sigmoids"
 
 SVMDigitClassifier::SVMDigitClassifier(const DigitExtractor& extractor, size_t sample_width, size_t pcaComponents)
   : DigitClassifier(extractor, sample_width, pcaComponents),
-    _svm(nullptr)
+    _c(0.0),
+    _gamma(0.0)
 {
 }
 
 SVMDigitClassifier::~SVMDigitClassifier()
 {
-  cleanup();
 }
 
 void SVMDigitClassifier::train(const std::vector<cv::Mat>* trainingImages)
 {
-  cleanup();
+  std::shared_ptr<SVMModel> model = std::make_shared<SVMModel>();
 
   cv::Mat trainingMat, labelMat;
-  prepareTrainingMat(trainingImages, trainingMat, labelMat);
+  prepareTrainingMat(trainingImages, trainingMat, labelMat, *model);
+
+  if (_c > 0.0 && _gamma > 0.0)
+    model->svm.train(trainingMat, labelMat, cv::Mat(), cv::Mat(), createParams());
+  else
+    model->svm.train_auto(trainingMat, labelMat, cv::Mat(), cv::Mat(), createParams());
+  if (model->svm.exportTo(model->engine))
+    calibrate(trainingMat, labelMat, model->svm.get_params(), model->engine);
+  setModel(model);
+}
+
+void SVMDigitClassifier::calibrate(const cv::Mat& trainingMat, const cv::Mat& labelMat, const cv::SVMParams& params,
+                                   RBFSVMEngine& engine) const
+{
+  // image i of each digit goes to fold i % SVM_CALIBRATION_FOLDS, so every fold holds all digits
+  std::vector<int> folds(trainingMat.rows);
+  std::vector<int> counts(NUM_DIGITS + 1, 0);
+  for (int row = 0; row < trainingMat.rows; ++row)
+  {
+    int label = labelMat.at<int>(row, 0);
+    folds[row] = label >= 1 && label <= NUM_DIGITS ? counts[label]++ % SVM_CALIBRATION_FOLDS : 0;
+  }
+
+  // like libsvm, the decision value of every sample comes from an SVM that was not trained on it
+  cv::Mat values(trainingMat.rows, engine.decisionCount(), CV_64FC1);
+  for (int fold = 0; fold < SVM_CALIBRATION_FOLDS; ++fold)
+  {
+    cv::Mat foldTraining, foldLabels, heldOut;
+    std::vector<int> heldOutRows;
+    for (int row = 0; row < trainingMat.rows; ++row)
+    {
+      if (folds[row] == fold)
+      {
+        heldOut.push_back(trainingMat.row(row));
+        heldOutRows.push_back(row);
+      }
+      else
+      {
+        foldTraining.push_back(trainingMat.row(row));
+        foldLabels.push_back(labelMat.row(row));
+      }
+    }
+
+    // too few samples for a fold leave the default sigmoids
+    ExportableSVM svm;
+    RBFSVMEngine foldEngine;
+    if (heldOut.empty() || ! svm.train(foldTraining, foldLabels, cv::Mat(), cv::Mat(), params)
+        || ! svm.exportTo(foldEngine) || foldEngine.decisionCount() != engine.decisionCount())
+      return;
+
+    cv::Mat foldValues;
+    foldEngine.decisionValues(heldOut, foldValues);
+    for (size_t i = 0; i < heldOutRows.size(); ++i)
+      foldValues.row(i).copyTo(values.row(heldOutRows[i]));
+  }
+
+  engine.calibrate(values, labelMat);
+}
+
+void SVMDigitClassifier::predict(const Model& model, const cv::Mat& samples, std::vector<Classification>& classifications) const
+{
+  const SVMModel& svmModel = static_cast<const SVMModel&>(model);
+  if (! svmModel.engine.empty())
+  {
+    svmModel.engine.predict(samples, classifications);
+    return;
+  }
 
-  cv::SVMParams params = create();
-  _svm->train_auto(trainingMat, labelMat, cv::Mat(), cv::Mat(), params);
+  // other kernels only get the winning label
+  ParallelUtils::parallelFor(samples.rows, [&](int i)
+  {
+    Classification& classification = classifications[i];
+    uchar label = static_cast<uchar>(svmModel.svm.predict(samples.row(i)));
+    if (label >= 1 && label <= NUM_DIGITS)
+      classification.scores[label - 1] = 1.f;
+    classification.finish(label);
+  });
 }
 
-uchar SVMDigitClassifier::classify(const cv::Mat& image)
+size_t SVMDigitClassifier::supportVectorCount() const
 {
-  if (! _svm)
-    return NO_DIGIT_FOUND;
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return 0;
 
-  cv::Mat prepared = prepareDigitMat(image);
-  float response = _svm->predict(prepared);
+  const SVMModel& svmModel = static_cast<const SVMModel&>(*current);
+  return svmModel.engine.empty() ? svmModel.svm.get_support_vector_count() : svmModel.engine.supportVectorCount();
+}
 
-  return static_cast<uchar>(response);
+void SVMDigitClassifier::setParameters(double c, double gamma)
+{
+  _c = c;
+  _gamma = gamma;
+}
+
+bool SVMDigitClassifier::ExportableSVM::exportTo(RBFSVMEngine& engine) const
+{
+  engine.clear();
+  if (! decision_func || ! class_labels || params.svm_type != C_SVC || params.kernel_type != RBF)
+    return false;
+
+  int classCount = class_labels->cols;
+  for (int i = 0; i < classCount; ++i)
+    engine.addClass(class_labels->data.i[i]);
+
+  engine.setSupportVectors(sv, sv_total, var_count, params.gamma);
+
+  const CvSVMDecisionFunc *df = decision_func;
+  for (int i = 0; i < classCount * (classCount - 1) / 2; ++i, ++df)
+  {
+    if (! df->sv_index)
+    {
+      engine.clear();
+      return false;
+    }
+    engine.addDecision(df->rho, df->sv_index, df->alpha, df->sv_count);
+  }
+
+  return true;
 }
 
 bool SVMDigitClassifier::load(const std::string& filename)
 {
-  cleanup();
-  create();
-  try
+  std::shared_ptr<SVMModel> model = std::make_shared<SVMModel>();
+
+  if (BinaryModelReader::isBinaryModel(filename))
   {
-    _svm->load(filename.c_str());
+    BinaryModelReader reader;
+    if (! reader.open(filename) || ! readPreprocessing(reader, *model) || ! model->engine.read(reader)
+        || reader.header().varCount != inputSize(*model))
+      return false;
+
+    setModel(model);
     return true;
   }
+
+  try
+  {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (! fs.isOpened() || ! readPreprocessing(fs, *model))
+      return false;
+
+    cv::FileNode node = fs[SVM_NODE_NAME];
+    if (node.empty())
+      return false;
+    model->svm.read(*fs, *node);
+    if (model->svm.get_var_count() != static_cast<int>(inputSize(*model)))
+      return false;
+
+    // one row of a and b per decision, files without them use the default sigmoids
+    cv::Mat sigmoids;
+    fs[SIGMOIDS_NODE_NAME] >> sigmoids;
+    if (model->svm.exportTo(model->engine) && ! sigmoids.empty())
+    {
+      if (sigmoids.cols != 2 || sigmoids.type() != CV_64FC1)
+        return false;
+
+      std::vector<RBFSVMEngine::Sigmoid> fitted(sigmoids.rows);
+      for (int d = 0; d < sigmoids.rows; ++d)
+      {
+        fitted[d].a = sigmoids.at<double>(d, 0);
+        fitted[d].b = sigmoids.at<double>(d, 1);
+      }
+      if (! model->engine.setSigmoids(fitted))
+        return false;
+    }
+  }
   catch (...)
   {
     return false;
   }
+
+  setModel(model);
+  return true;
 }
 
 bool SVMDigitClassifier::save(const std::string& filename) const
 {
+  std::shared_ptr<const Model> current = model();
+  if (! current)
+    return false;
+
+  const SVMModel& svmModel = static_cast<const SVMModel&>(*current);
+  if (BinaryModelWriter::isBinaryFilename(filename))
+  {
+    if (svmModel.engine.empty())
+      return false;
+
+    BinaryModelWriter writer;
+    writePreprocessing(svmModel, writer);
+    svmModel.engine.write(writer);
+    return writer.write(filename);
+  }
+
+  // models loaded from binary files only have the engine
+  if (svmModel.svm.get_support_vector_count() == 0)
+    return false;
+
   try
   {
-    if (_svm)
-    {
-      _svm->save(filename.c_str());
-      return true;
-    }
-    else
-    {
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    if (! fs.isOpened())
       return false;
+
+    writePreprocessing(fs, svmModel);
+    svmModel.svm.write(*fs, SVM_NODE_NAME);
+
+    std::vector<RBFSVMEngine::Sigmoid> fitted = svmModel.engine.sigmoids();
+    if (! fitted.empty())
+    {
+      cv::Mat sigmoids(fitted.size(), 2, CV_64FC1);
+      for (size_t d = 0; d < fitted.size(); ++d)
+      {
+        sigmoids.at<double>(d, 0) = fitted[d].a;
+        sigmoids.at<double>(d, 1) = fitted[d].b;
+      }
+      fs << SIGMOIDS_NODE_NAME << sigmoids;
     }
+    return true;
   }
   catch (...)
   {
@@ -68,19 +247,17 @@ bool SVMDigitClassifier::save(const std::string& filename) const
   }
 }
 
-cv::SVMParams SVMDigitClassifier::create()
+cv::SVMParams SVMDigitClassifier::createParams() const
 {
   cv::SVMParams svm_params;
   svm_params.svm_type = cv::SVM::C_SVC;
   svm_params.kernel_type = cv::SVM::RBF;
-
-  _svm = new cv::SVM();
+  // otherwise OpenCV's defaults, which train_auto replaces with the best of its grid
+  if (_c > 0.0 && _gamma > 0.0)
+  {
+    svm_params.C = _c;
+    svm_params.gamma = _gamma;
+  }
 
   return svm_params;
 }
-
-void SVMDigitClassifier::cleanup()
-{
-  if (_svm)
-    delete _svm;
-}
@@ -0,0 +1,44 @@
+#include "../../include/classification/trainingset.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <sstream>
+
+bool TrainingSet::load(const std::string& directory, std::vector<cv::Mat> *samples)
+{
+  for (int i = 0; i < 9; ++i)
+  {
+    std::stringstream ss;
+    ss << directory << "/" << (i + 1) << "/*.png";
+
+    std::vector<std::string> files;
+    try
+    {
+      cv::glob(ss.str(), files);
+    }
+    catch (...)
+    {
+      return false;
+    }
+
+    if (files.empty())
+      return false;
+
+    for (const std::string& file : files)
+    {
+      cv::Mat m = cv::imread(file);
+      if (! m.empty())
+        samples[i].push_back(m);
+    }
+  }
+
+  return true;
+}
+
+size_t TrainingSet::size(const std::vector<cv::Mat> *samples)
+{
+  size_t count = 0;
+  for (int i = 0; i < 9; ++i)
+    count += samples[i].size();
+  return count;
+}
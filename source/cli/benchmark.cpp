@@ -0,0 +1,416 @@
+#include "../../include/settings.hpp"
+#include "../../include/classification/cascadedigitclassifier.hpp"
+#include "../../include/classification/knndigitclassifier.hpp"
+#include "../../include/classification/nndigitclassifier.hpp"
+#include "../../include/classification/svmdigitclassifier.hpp"
+#include "../../include/classification/trainingset.hpp"
+#include "../../include/imgproc/digitextractor.hpp"
+#include "../../include/imgproc/sudokufinder.hpp"
+#include "../../include/pipeline/exactdigitvoter.hpp"
+#include "../../include/pipeline/likelihooddigitvoter.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// minimum time the queries of one configuration are repeated for
+#define BENCHMARK_MIN_SECONDS 0.5
+// simulated frames per test image in the voting benchmark
+#define VOTING_BENCHMARK_FRAMES 24
+
+static void printUsage()
+{
+  std::cerr << "usage: vsudoku-benchmark <training set directory> [benchmark...]" << std::endl
+            << "  knn       kNN query latency against the training set size" << std::endl
+            << "  mlp       accuracy and latency of the float and the int8 MLP" << std::endl
+            << "  features  SVM size, accuracy and latency with pixel and HOG features" << std::endl
+            << "  cascade   accuracy, latency and escalation rate of the MLP to SVM cascade" << std::endl
+            << "  voting    frames until the exact and the likelihood voter fix a jittered cell" << std::endl;
+}
+
+static double elapsedMs(int64 startTicks)
+{
+  return (cv::getTickCount() - startTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+// the training set scaled to factor times its size, larger sets get copies shifted by one pixel
+static void scaleTrainingSet(const std::vector<cv::Mat> *images, double factor, std::vector<cv::Mat> *scaled)
+{
+  static const int shifts[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+
+  for (int digit = 0; digit < 9; ++digit)
+  {
+    scaled[digit].clear();
+    size_t count = static_cast<size_t>(images[digit].size() * factor + 0.5);
+    for (size_t i = 0; i < count; ++i)
+    {
+      const cv::Mat& image = images[digit][i % images[digit].size()];
+      size_t copy = i / images[digit].size();
+      if (copy == 0)
+      {
+        scaled[digit].push_back(image);
+        continue;
+      }
+
+      const int *shift = shifts[(copy - 1) % 8];
+      cv::Mat translation = (cv::Mat_<double>(2, 3) << 1, 0, shift[0] * ((copy - 1) / 8 + 1),
+                                                        0, 1, shift[1] * ((copy - 1) / 8 + 1));
+      cv::Mat shifted;
+      cv::warpAffine(image, shifted, translation, image.size(), cv::INTER_NEAREST, cv::BORDER_REPLICATE);
+      scaled[digit].push_back(shifted);
+    }
+  }
+}
+
+// microseconds per query, classifications receives the results of the last run
+static double measureQueries(const DigitClassifier& classifier, const std::vector<cv::Mat>& queries,
+                             std::vector<Classification>& classifications)
+{
+  size_t runs = 0;
+  int64 startTicks = cv::getTickCount();
+  do
+  {
+    classifier.classifyBatch(queries, classifications);
+    ++runs;
+  }
+  while (elapsedMs(startTicks) < BENCHMARK_MIN_SECONDS * 1000.0);
+
+  return elapsedMs(startTicks) * 1000.0 / (runs * queries.size());
+}
+
+static void benchmarkKNN(const DigitExtractor& extractor, const std::vector<cv::Mat> *images, const std::vector<cv::Mat>& queries)
+{
+  static const double factors[] = {0.125, 0.25, 0.5, 1.0, 2.0, 4.0, 8.0};
+  static const size_t pcaComponents[] = {0, 32};
+
+  std::cout << "kNN, k = " << KNN_K << ", " << queries.size() << " queries" << std::endl
+            << std::setw(10) << "samples" << std::setw(6) << "pca" << std::setw(14) << "search"
+            << std::setw(12) << "train ms" << std::setw(12) << "query us" << std::setw(12) << "agreement" << std::endl;
+
+  for (double factor : factors)
+  {
+    std::vector<cv::Mat> scaled[9];
+    scaleTrainingSet(images, factor, scaled);
+
+    for (size_t pca : pcaComponents)
+    {
+      std::vector<Classification> exact;
+      for (int search = KNNDigitClassifier::SEARCH_BRUTE_FORCE; search <= KNNDigitClassifier::SEARCH_KD_TREE; ++search)
+      {
+        KNNDigitClassifier classifier(extractor, DIGIT_SAMPLE_WIDTH, KNN_K, pca, static_cast<KNNDigitClassifier::Search>(search));
+
+        int64 startTicks = cv::getTickCount();
+        classifier.train(scaled);
+        double trainMs = elapsedMs(startTicks);
+
+        std::vector<Classification> classifications;
+        double queryUs = measureQueries(classifier, queries, classifications);
+
+        // the KD-tree search is approximate, brute force gives the exact neighbours
+        if (search == KNNDigitClassifier::SEARCH_BRUTE_FORCE)
+          exact = classifications;
+        size_t agreeing = 0;
+        for (size_t i = 0; i < classifications.size(); ++i)
+          if (classifications[i].label == exact[i].label)
+            ++agreeing;
+
+        std::cout << std::setw(10) << TrainingSet::size(scaled) << std::setw(6) << pca
+                  << std::setw(14) << (search == KNNDigitClassifier::SEARCH_KD_TREE ? "kd-tree" : "brute force")
+                  << std::setw(12) << trainMs << std::setw(12) << queryUs
+                  << std::setw(11) << 100.0 * agreeing / classifications.size() << "%" << std::endl;
+      }
+    }
+  }
+}
+
+// every second image of each digit trains, the others test
+static void splitTrainingSet(const std::vector<cv::Mat> *images, std::vector<cv::Mat> *training,
+                             std::vector<cv::Mat>& tests, std::vector<uchar>& labels)
+{
+  for (int digit = 0; digit < 9; ++digit)
+  {
+    for (size_t i = 0; i < images[digit].size(); ++i)
+    {
+      if (i % 2 == 0)
+      {
+        training[digit].push_back(images[digit][i]);
+      }
+      else
+      {
+        tests.push_back(images[digit][i]);
+        labels.push_back(static_cast<uchar>(digit + 1));
+      }
+    }
+  }
+}
+
+static double accuracy(const std::vector<Classification>& classifications, const std::vector<uchar>& labels)
+{
+  size_t correct = 0;
+  for (size_t i = 0; i < labels.size(); ++i)
+    if (classifications[i].label == labels[i])
+      ++correct;
+
+  return labels.empty() ? 0.0 : 100.0 * correct / labels.size();
+}
+
+static void benchmarkMLP(const DigitExtractor& extractor, const std::vector<cv::Mat> *images, const std::vector<cv::Mat>& queries)
+{
+  std::vector<cv::Mat> training[9], tests;
+  std::vector<uchar> labels;
+  splitTrainingSet(images, training, tests, labels);
+
+  NNDigitClassifier classifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  int64 startTicks = cv::getTickCount();
+  classifier.train(training);
+  double trainMs = elapsedMs(startTicks);
+
+  std::cout << "MLP, trained on " << TrainingSet::size(training) << " images in " << trainMs << " ms, tested on "
+            << tests.size() << " images, latency of " << queries.size() << " queries" << std::endl
+            << std::setw(10) << "weights" << std::setw(12) << "accuracy" << std::setw(12) << "query us" << std::endl;
+
+  double floatAccuracy = 0.0, floatUs = 0.0;
+  for (int quantized = 0; quantized <= 1; ++quantized)
+  {
+    classifier.setQuantized(quantized);
+
+    std::vector<Classification> classifications;
+    classifier.classifyBatch(tests, classifications);
+    double testAccuracy = accuracy(classifications, labels);
+    double queryUs = measureQueries(classifier, queries, classifications);
+
+    std::cout << std::setw(10) << (quantized ? "int8" : "float") << std::setw(11) << testAccuracy << "%"
+              << std::setw(12) << queryUs << std::endl;
+
+    if (! quantized)
+    {
+      floatAccuracy = testAccuracy;
+      floatUs = queryUs;
+    }
+    else
+    {
+      std::cout << "int8 accuracy delta " << testAccuracy - floatAccuracy << " points, speedup "
+                << (queryUs > 0.0 ? floatUs / queryUs : 0.0) << "x" << std::endl;
+    }
+  }
+}
+
+static void benchmarkFeatures(const DigitExtractor& extractor, const std::vector<cv::Mat> *images, const std::vector<cv::Mat>& queries)
+{
+  std::vector<cv::Mat> training[9], tests;
+  std::vector<uchar> labels;
+  splitTrainingSet(images, training, tests, labels);
+
+  std::cout << "SVM, trained on " << TrainingSet::size(training) << " images, tested on "
+            << tests.size() << " images, latency of " << queries.size() << " queries" << std::endl
+            << std::setw(10) << "features" << std::setw(8) << "values" << std::setw(12) << "train ms"
+            << std::setw(8) << "SVs" << std::setw(12) << "accuracy" << std::setw(12) << "query us" << std::endl;
+
+  for (int features = DigitFeatures::FEATURES_PIXELS; features <= DigitFeatures::FEATURES_HOG; ++features)
+  {
+    DigitFeatures::Type type = static_cast<DigitFeatures::Type>(features);
+    SVMDigitClassifier classifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+    classifier.setFeatures(type);
+
+    int64 startTicks = cv::getTickCount();
+    classifier.train(training);
+    double trainMs = elapsedMs(startTicks);
+
+    std::vector<Classification> classifications;
+    classifier.classifyBatch(tests, classifications);
+    double testAccuracy = accuracy(classifications, labels);
+    double queryUs = measureQueries(classifier, queries, classifications);
+
+    std::cout << std::setw(10) << DigitFeatures::name(type) << std::setw(8) << DigitFeatures::size(type, DIGIT_SAMPLE_WIDTH)
+              << std::setw(12) << trainMs << std::setw(8) << classifier.supportVectorCount()
+              << std::setw(11) << testAccuracy << "%" << std::setw(12) << queryUs << std::endl;
+  }
+}
+
+static void benchmarkCascade(const DigitExtractor& extractor, const std::vector<cv::Mat> *images, const std::vector<cv::Mat>& queries)
+{
+  static const float minConfidences[] = {0.5f, 0.7f, 0.8f, 0.9f, 0.95f};
+
+  std::vector<cv::Mat> training[9], tests;
+  std::vector<uchar> labels;
+  splitTrainingSet(images, training, tests, labels);
+
+  std::cout << "Cascade, trained on " << TrainingSet::size(training) << " images, tested on "
+            << tests.size() << " images, latency of " << queries.size() << " queries" << std::endl
+            << std::setw(16) << "classifier" << std::setw(12) << "accuracy" << std::setw(12) << "query us"
+            << std::setw(12) << "escalated" << std::endl;
+
+  std::vector<Classification> classifications;
+
+  NNDigitClassifier nn(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS, true);
+  nn.train(training);
+  nn.classifyBatch(tests, classifications);
+  std::cout << std::setw(16) << "int8 mlp" << std::setw(11) << accuracy(classifications, labels) << "%"
+            << std::setw(12) << measureQueries(nn, queries, classifications) << std::endl;
+
+  SVMDigitClassifier svm(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  svm.train(training);
+  svm.classifyBatch(tests, classifications);
+  std::cout << std::setw(16) << "svm" << std::setw(11) << accuracy(classifications, labels) << "%"
+            << std::setw(12) << measureQueries(svm, queries, classifications) << std::endl;
+
+  for (float minConfidence : minConfidences)
+  {
+    CascadeDigitClassifier cascade(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS, minConfidence);
+    cascade.train(training);
+    cascade.classifyBatch(tests, classifications);
+    double testAccuracy = accuracy(classifications, labels);
+    double escalated = 100.0 * cascade.escalationRate();
+
+    std::stringstream name;
+    name << "cascade " << minConfidence;
+    std::cout << std::setw(16) << name.str() << std::setw(11) << testAccuracy << "%"
+              << std::setw(12) << measureQueries(cascade, queries, classifications)
+              << std::setw(11) << escalated << "%" << std::endl;
+  }
+}
+
+// one simulated camera frame of a cell: small rotation, scale and shift, gain, offset and sensor noise
+static cv::Mat jitter(const cv::Mat& image, cv::RNG& rng)
+{
+  cv::Point2f center(image.cols / 2.0f + rng.uniform(-1.5f, 1.5f), image.rows / 2.0f + rng.uniform(-1.5f, 1.5f));
+  cv::Mat rotation = cv::getRotationMatrix2D(center, rng.uniform(-3.0, 3.0), rng.uniform(0.95, 1.05));
+
+  cv::Mat frame;
+  cv::warpAffine(image, frame, rotation, image.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+  frame.convertTo(frame, CV_32F, rng.uniform(0.8, 1.2), rng.uniform(-20.0, 20.0));
+
+  cv::Mat noise(frame.size(), frame.type());
+  rng.fill(noise, cv::RNG::NORMAL, 0.0, 6.0);
+  frame += noise;
+  frame.convertTo(frame, CV_8U);
+
+  return frame;
+}
+
+static void benchmarkVoting(const DigitExtractor& extractor, const std::vector<cv::Mat> *images)
+{
+  std::vector<cv::Mat> training[9], tests;
+  std::vector<uchar> labels;
+  splitTrainingSet(images, training, tests, labels);
+
+  SVMDigitClassifier classifier(extractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
+  classifier.train(training);
+
+  // every test image becomes a cell seen for VOTING_BENCHMARK_FRAMES jittered frames
+  cv::RNG rng(7);
+  std::vector<cv::Mat> frames;
+  for (const cv::Mat& test : tests)
+    for (size_t frame = 0; frame < VOTING_BENCHMARK_FRAMES; ++frame)
+      frames.push_back(jitter(test, rng));
+
+  std::vector<Classification> classifications;
+  classifier.classifyBatch(frames, classifications);
+
+  std::vector<uchar> frameLabels;
+  for (uchar label : labels)
+    frameLabels.insert(frameLabels.end(), VOTING_BENCHMARK_FRAMES, label);
+
+  std::cout << "Voting, SVM trained on " << TrainingSet::size(training) << " images, " << tests.size()
+            << " cells of " << VOTING_BENCHMARK_FRAMES << " frames, per frame accuracy "
+            << accuracy(classifications, frameLabels) << "%" << std::endl
+            << std::setw(12) << "voter" << std::setw(10) << "fixed" << std::setw(10) << "frames"
+            << std::setw(10) << "wrong" << std::endl;
+
+  ExactDigitVoter exact;
+  LikelihoodDigitVoter likelihood;
+  DigitVoter *voters[] = {&exact, &likelihood};
+  const char *names[] = {"exact", "likelihood"};
+
+  for (size_t v = 0; v < 2; ++v)
+  {
+    DigitVoter& voter = *voters[v];
+    size_t fixed = 0, frameSum = 0, wrong = 0;
+    for (size_t cell = 0; cell < tests.size(); ++cell)
+    {
+      voter.reset();
+      for (size_t frame = 0; frame < VOTING_BENCHMARK_FRAMES; ++frame)
+      {
+        if (voter.add(classifications[cell * VOTING_BENCHMARK_FRAMES + frame], true))
+        {
+          ++fixed;
+          frameSum += voter.frames();
+          if (voter.digit() != labels[cell])
+            ++wrong;
+          break;
+        }
+      }
+    }
+
+    std::cout << std::setw(12) << names[v] << std::setw(9) << 100.0 * fixed / tests.size() << "%"
+              << std::setw(10) << (fixed ? static_cast<double>(frameSum) / fixed : 0.0)
+              << std::setw(10) << wrong << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<std::string> benchmarks(argv + 2, argv + argc);
+  if (benchmarks.empty())
+    benchmarks = {"knn", "mlp", "features", "cascade", "voting"};
+
+  std::vector<cv::Mat> images[9];
+  if (! TrainingSet::load(argv[1], images))
+  {
+    std::cerr << "Cannot read training set " << argv[1] << std::endl;
+    return 1;
+  }
+
+  // a grid worth of cells, taken evenly from all digits
+  std::vector<cv::Mat> queries;
+  for (size_t i = 0; queries.size() < NUM_ROWS_CELLS * NUM_ROWS_CELLS; ++i)
+  {
+    const std::vector<cv::Mat>& digitImages = images[i % 9];
+    queries.push_back(digitImages[(i / 9) % digitImages.size()]);
+  }
+
+  SudokuFinder sudokuFinder(SUDOKU_CELL_WORKING_SIZE, DIRECT_CELL_SAMPLE_SIZE);
+  DigitExtractor extractor(sudokuFinder);
+
+  for (const std::string& benchmark : benchmarks)
+  {
+    if (benchmark == "knn")
+    {
+      benchmarkKNN(extractor, images, queries);
+    }
+    else if (benchmark == "mlp")
+    {
+      benchmarkMLP(extractor, images, queries);
+    }
+    else if (benchmark == "features")
+    {
+      benchmarkFeatures(extractor, images, queries);
+    }
+    else if (benchmark == "cascade")
+    {
+      benchmarkCascade(extractor, images, queries);
+    }
+    else if (benchmark == "voting")
+    {
+      benchmarkVoting(extractor, images);
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "../../include/classification/binarymodel.hpp"
+#include "../../include/pipeline/sudokupipeline.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage()
+{
+  std::cerr << "usage: vsudoku-convert [options] <classifier> <binary classifier" << BINARY_MODEL_EXTENSION << ">" << std::endl
+            << "  --backend <type>  the classifier is a knn, svm, nn or cascade (default "
+            << ClassifierBackend::name(static_cast<ClassifierBackend::Type>(CLASSIFIER_BACKEND)) << ")" << std::endl;
+}
+
+static double elapsedMs(int64 startTicks)
+{
+  return (cv::getTickCount() - startTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+int main(int argc, char **argv)
+{
+  ClassifierBackend::Type backend = static_cast<ClassifierBackend::Type>(CLASSIFIER_BACKEND);
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    if (arg == "--backend" && i + 1 < argc)
+    {
+      if (! ClassifierBackend::parse(argv[++i], backend))
+      {
+        printUsage();
+        return 1;
+      }
+    }
+    else
+    {
+      files.push_back(arg);
+    }
+  }
+
+  if (files.size() != 2 || ! BinaryModelWriter::isBinaryFilename(files[1]))
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::string input(files[0]), output(files[1]);
+
+  SudokuPipeline pipeline;
+  pipeline.setClassifierBackend(backend);
+  int64 startTicks = cv::getTickCount();
+  if (! pipeline.loadClassifier(input))
+  {
+    std::cerr << "Cannot load classifier " << input << std::endl;
+    return 1;
+  }
+  double inputMs = elapsedMs(startTicks);
+
+  if (! pipeline.saveClassifier(output))
+  {
+    std::cerr << "Cannot write binary classifier " << output << std::endl;
+    return 1;
+  }
+
+  // the converted model has to load again
+  SudokuPipeline converted;
+  converted.setClassifierBackend(backend);
+  startTicks = cv::getTickCount();
+  if (! converted.loadClassifier(output))
+  {
+    std::cerr << "Cannot load the written classifier " << output << std::endl;
+    return 1;
+  }
+  double outputMs = elapsedMs(startTicks);
+
+  std::cout << "loaded " << input << " in " << inputMs << " ms, "
+            << output << " in " << outputMs << " ms" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,266 @@
+#include "../../include/settings.hpp"
+#include "../../include/capture/framesource.hpp"
+#include "../../include/capture/memoryframesource.hpp"
+#include "../../include/classification/trainingset.hpp"
+#include "../../include/pipeline/sudokupipeline.hpp"
+#include "../../include/pipeline/stagedpipeline.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void printUsage()
+{
+  std::cerr << "usage: vsudoku-cli [options] <camera number | video file | image directory | image file>" << std::endl
+            << "  --backend <type>     classify with knn, svm, nn or cascade (default "
+            << ClassifierBackend::name(static_cast<ClassifierBackend::Type>(CLASSIFIER_BACKEND)) << ")" << std::endl
+            << "  --classifier <file>  load a trained classifier" << std::endl
+            << "  --train <dir>        train the classifier from a training set directory" << std::endl
+            << "  --features <type>    features to train with, pixels or hog (default "
+            << DigitFeatures::name(static_cast<DigitFeatures::Type>(DIGIT_FEATURES)) << ")" << std::endl
+            << "  --cell-sample-size <n>  sample each cell from the frame at n x n pixels, 0 rectifies the grid (default "
+            << DIRECT_CELL_SAMPLE_SIZE << ")" << std::endl
+            << "  --realtime           pause between frames like the live application" << std::endl
+            << "  --staged             run capture, detection, recognition and rendering on separate threads" << std::endl
+            << "  --repeat <n>         feed a single image n times (default " << NUM_FRAMES_FIXED << ")" << std::endl
+            << "  --verbose            print the recognized grid after every frame" << std::endl;
+}
+
+static bool isImageFile(const std::string& filename)
+{
+  size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+
+  std::string extension = filename.substr(dot + 1);
+  std::transform(std::begin(extension), std::end(extension), std::begin(extension), ::tolower);
+
+  return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "bmp";
+}
+
+static void printGrid(const uchar grid[NUM_ROWS_CELLS][NUM_ROWS_CELLS], const bool fixed[NUM_ROWS_CELLS][NUM_ROWS_CELLS])
+{
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      if (fixed && ! fixed[row][col])
+        std::cout << "? ";
+      else if (grid[row][col] == NO_DIGIT_FOUND)
+        std::cout << ". ";
+      else
+        std::cout << static_cast<int>(grid[row][col]) << " ";
+    }
+    std::cout << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::string location, classifierFile, trainingDir;
+  bool realtime = false;
+  bool staged = false;
+  bool verbose = false;
+  size_t repeat = NUM_FRAMES_FIXED;
+  size_t cellSampleSize = DIRECT_CELL_SAMPLE_SIZE;
+  DigitFeatures::Type features = static_cast<DigitFeatures::Type>(DIGIT_FEATURES);
+  ClassifierBackend::Type backend = static_cast<ClassifierBackend::Type>(CLASSIFIER_BACKEND);
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    if (arg == "--classifier" && i + 1 < argc)
+      classifierFile = argv[++i];
+    else if (arg == "--backend" && i + 1 < argc)
+    {
+      if (! ClassifierBackend::parse(argv[++i], backend))
+      {
+        printUsage();
+        return 1;
+      }
+    }
+    else if (arg == "--train" && i + 1 < argc)
+      trainingDir = argv[++i];
+    else if (arg == "--features" && i + 1 < argc)
+    {
+      if (! DigitFeatures::parse(argv[++i], features))
+      {
+        printUsage();
+        return 1;
+      }
+    }
+    else if (arg == "--cell-sample-size" && i + 1 < argc)
+      cellSampleSize = std::max(0, std::atoi(argv[++i]));
+    else if (arg == "--repeat" && i + 1 < argc)
+      repeat = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--realtime")
+      realtime = true;
+    else if (arg == "--staged")
+      staged = true;
+    else if (arg == "--verbose")
+      verbose = true;
+    else if (! arg.empty() && arg[0] == '-')
+    {
+      printUsage();
+      return 1;
+    }
+    else
+      location = arg;
+  }
+
+  if (location.empty())
+  {
+    printUsage();
+    return 1;
+  }
+
+  FrameSource::Pacing pacing = realtime ? FrameSource::PACING_REALTIME : FrameSource::PACING_AS_FAST_AS_POSSIBLE;
+  std::unique_ptr<FrameSource> frameSource;
+  if (isImageFile(location))
+  {
+    cv::Mat image = cv::imread(location);
+    if (image.empty())
+    {
+      std::cerr << "Cannot read image " << location << std::endl;
+      return 1;
+    }
+    frameSource.reset(new MemoryFrameSource(std::vector<cv::Mat>(repeat, image), pacing));
+  }
+  else
+  {
+    frameSource.reset(FrameSource::open(location, pacing));
+  }
+
+  if (! frameSource->isOpened())
+  {
+    std::cerr << "Could not open " << frameSource->description() << std::endl;
+    return 1;
+  }
+
+  SudokuPipeline pipeline;
+  pipeline.setAutoSolve(true);
+  pipeline.setCellSampleSize(cellSampleSize);
+  pipeline.setClassifierBackend(backend);
+
+  if (! trainingDir.empty())
+  {
+    std::vector<cv::Mat> trainingImages[9];
+    if (! TrainingSet::load(trainingDir, trainingImages))
+    {
+      std::cerr << "Cannot read training set " << trainingDir << std::endl;
+      return 1;
+    }
+    std::cerr << "Training with " << TrainingSet::size(trainingImages) << " images..." << std::endl;
+    pipeline.setClassifierFeatures(features);
+    pipeline.train(trainingImages);
+  }
+  else if (! classifierFile.empty() && ! pipeline.loadClassifier(classifierFile))
+  {
+    std::cerr << "Cannot load classifier " << classifierFile << std::endl;
+    return 1;
+  }
+
+  if (! pipeline.hasClassifier())
+    std::cerr << "No classifier given, only detecting the grid" << std::endl;
+
+  size_t frameCount = 0;
+  size_t foundCount = 0;
+  PipelineResult result;
+  PipelineResult lastFound = PipelineResult();
+
+  int64 startTicks = cv::getTickCount();
+
+  auto handleResult = [&](const PipelineResult& result, double latencyMs)
+  {
+    ++frameCount;
+    if (result.found)
+    {
+      ++foundCount;
+      lastFound = result;
+    }
+
+    if (verbose)
+    {
+      std::cout << "frame " << frameCount << (result.found ? "" : " (no sudoku)")
+                << ", latency " << latencyMs << " ms" << std::endl;
+      if (result.found)
+        printGrid(result.digits, nullptr);
+    }
+  };
+
+  size_t droppedCount = 0;
+  double meanLatencyMs = 0.0, maxLatencyMs = 0.0;
+  if (staged)
+  {
+    StagedPipeline stagedPipeline(pipeline, *frameSource);
+    stagedPipeline.start([&](const PipelineFrame& frame) { handleResult(frame.result, frame.ageMs()); });
+    stagedPipeline.wait();
+    droppedCount = stagedPipeline.droppedFrames();
+    meanLatencyMs = stagedPipeline.meanLatencyMs();
+    maxLatencyMs = stagedPipeline.maxLatencyMs();
+  }
+  else
+  {
+    cv::Mat frame;
+    int64 captureTicks;
+    while (frameSource->readTimestamped(frame, captureTicks))
+    {
+      pipeline.process(frame, result);
+
+      double latencyMs = (cv::getTickCount() - captureTicks) * 1000.0 / cv::getTickFrequency();
+      meanLatencyMs += latencyMs;
+      maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+      handleResult(result, latencyMs);
+
+      if (! frameSource->isLive() && frameSource->getPacing() == FrameSource::PACING_REALTIME)
+        std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_DELAY_MS));
+    }
+    droppedCount = frameSource->droppedFrames();
+  }
+
+  double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+  if (! staged && frameCount > 0)
+    meanLatencyMs /= frameCount;
+
+  if (foundCount > 0)
+  {
+    std::cout << "grid:" << std::endl;
+    printGrid(lastFound.digits, lastFound.fixed);
+    if (lastFound.solved)
+    {
+      std::cout << "solution:" << std::endl;
+      printGrid(lastFound.solution, nullptr);
+    }
+  }
+
+  std::cout << "frames: " << frameCount
+            << ", with sudoku: " << foundCount
+            << ", dropped: " << droppedCount
+            << ", time: " << seconds << " s";
+  if (seconds > 0.0)
+    std::cout << ", " << frameCount / seconds << " fps";
+  std::cout << ", latency: " << meanLatencyMs << " ms mean, " << maxLatencyMs << " ms max" << std::endl;
+
+  std::cout << "searched: " << pipeline.sceneChangeCount(SudokuFinder::SCENE_CHANGED)
+            << ", tracked: " << pipeline.sceneChangeCount(SudokuFinder::SCENE_MOVED)
+            << ", reused: " << pipeline.sceneChangeCount(SudokuFinder::SCENE_STATIC)
+            << ", skip ratio: " << pipeline.skipRatio()
+            << ", classification cache hit rate: " << pipeline.cacheHitRate() << std::endl;
+
+  std::cout << "frames to lock: " << pipeline.meanFramesToLock() << " per digit"
+            << ", " << pipeline.lastGridFramesToLock() << " for the last sudoku" << std::endl;
+
+  if (backend == ClassifierBackend::BACKEND_CASCADE)
+    std::cout << "cascade escalation rate: " << pipeline.escalationRate() << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,495 @@
+#include "../../include/settings.hpp"
+#include "../../include/classification/classifierbackend.hpp"
+#include "../../include/classification/knndigitclassifier.hpp"
+#include "../../include/classification/nndigitclassifier.hpp"
+#include "../../include/classification/svmdigitclassifier.hpp"
+#include "../../include/classification/trainingset.hpp"
+#include "../../include/imgproc/digitextractor.hpp"
+#include "../../include/imgproc/sudokufinder.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#define TUNE_FOLDS 5
+// minimum time the queries of one configuration are repeated for
+#define TUNE_LATENCY_SECONDS 0.2
+
+struct Configuration
+{
+  ClassifierBackend::Type backend;
+  DigitFeatures::Type features;
+  size_t sampleWidth;
+  size_t pcaComponents;
+  size_t k;
+  double c;
+  double gamma;
+
+  // a new untrained classifier with this configuration
+  DigitClassifier* create(const DigitExtractor& extractor) const;
+  std::string parameters() const;
+};
+
+struct Evaluation
+{
+  Evaluation() : trainMs(0.0), modelBytes(0), queryUs(0.0)
+  {
+  }
+
+  double meanAccuracy() const;
+  double accuracyDeviation() const;
+
+  std::vector<double> accuracies;
+  double trainMs;
+  size_t modelBytes;
+  double queryUs;
+
+  // trained on all folds but the first, used for the size and the latency
+  std::unique_ptr<DigitClassifier> classifier;
+};
+
+DigitClassifier* Configuration::create(const DigitExtractor& extractor) const
+{
+  DigitClassifier *classifier;
+  if (backend == ClassifierBackend::BACKEND_KNN)
+  {
+    classifier = new KNNDigitClassifier(extractor, sampleWidth, k, pcaComponents);
+  }
+  else if (backend == ClassifierBackend::BACKEND_NN)
+  {
+    classifier = new NNDigitClassifier(extractor, sampleWidth, pcaComponents);
+  }
+  else
+  {
+    SVMDigitClassifier *svm = new SVMDigitClassifier(extractor, sampleWidth, pcaComponents);
+    svm->setParameters(c, gamma);
+    classifier = svm;
+  }
+
+  classifier->setFeatures(features);
+  return classifier;
+}
+
+std::string Configuration::parameters() const
+{
+  std::stringstream ss;
+  if (backend == ClassifierBackend::BACKEND_KNN)
+    ss << "k=" << k;
+  else if (backend == ClassifierBackend::BACKEND_SVM)
+    ss << "C=" << c << " gamma=" << gamma;
+  else
+    ss << "-";
+
+  return ss.str();
+}
+
+double Evaluation::meanAccuracy() const
+{
+  double sum = 0.0;
+  for (double accuracy : accuracies)
+    sum += accuracy;
+
+  return accuracies.empty() ? 0.0 : sum / accuracies.size();
+}
+
+double Evaluation::accuracyDeviation() const
+{
+  double mean = meanAccuracy();
+  double sum = 0.0;
+  for (double accuracy : accuracies)
+    sum += (accuracy - mean) * (accuracy - mean);
+
+  return accuracies.empty() ? 0.0 : std::sqrt(sum / accuracies.size());
+}
+
+static void printUsage()
+{
+  std::cerr << "usage: vsudoku-tune <training set directory> [options]" << std::endl
+            << "  --folds <n>          folds of the cross validation (default " << TUNE_FOLDS << ")" << std::endl
+            << "  --threads <n>        configurations trained at once (default: one per core)" << std::endl
+            << "  --backends <list>    backends to evaluate out of knn, svm and nn (default all)" << std::endl
+            << "  --features <list>    features out of pixels and hog (default both)" << std::endl
+            << "  --widths <list>      sample widths (default 12,16,20)" << std::endl
+            << "  --pca <list>         PCA components, 0 for none (default 0,32)" << std::endl
+            << "  --k <list>           kNN neighbours (default 1,3,5,7)" << std::endl
+            << "  --c <list>           SVM C (default 1,10,100)" << std::endl
+            << "  --gamma <list>       SVM gamma (default 0.005,0.02,0.08)" << std::endl
+            << "  --save <file>        train the most accurate configuration on the whole set and save it" << std::endl
+            << "Lists are comma separated, e.g. --widths 12,16." << std::endl;
+}
+
+static double elapsedMs(int64 startTicks)
+{
+  return (cv::getTickCount() - startTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+template<typename T>
+static bool parseList(const std::string& text, std::vector<T>& values)
+{
+  values.clear();
+
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    std::stringstream itemStream(item);
+    T value;
+    if (! (itemStream >> value) || ! itemStream.eof())
+      return false;
+    values.push_back(value);
+  }
+
+  return ! values.empty();
+}
+
+static bool parseBackends(const std::string& text, std::vector<ClassifierBackend::Type>& backends)
+{
+  std::vector<std::string> names;
+  if (! parseList(text, names))
+    return false;
+
+  // the cascade is made of an MLP and an SVM, which are tuned on their own
+  backends.clear();
+  for (const std::string& name : names)
+  {
+    ClassifierBackend::Type backend;
+    if (! ClassifierBackend::parse(name, backend) || backend == ClassifierBackend::BACKEND_CASCADE)
+      return false;
+    backends.push_back(backend);
+  }
+
+  return true;
+}
+
+static bool parseFeatures(const std::string& text, std::vector<DigitFeatures::Type>& features)
+{
+  std::vector<std::string> names;
+  if (! parseList(text, names))
+    return false;
+
+  features.clear();
+  for (const std::string& name : names)
+  {
+    DigitFeatures::Type type;
+    if (! DigitFeatures::parse(name, type))
+      return false;
+    features.push_back(type);
+  }
+
+  return true;
+}
+
+// image i of every digit tests in fold i % folds, so each fold holds all digits in their proportions
+static void splitFolds(const std::vector<cv::Mat> *images, size_t folds, std::vector<std::vector<cv::Mat> >& training,
+                       std::vector<std::vector<cv::Mat> >& tests, std::vector<std::vector<uchar> >& labels)
+{
+  training.assign(folds * 9, std::vector<cv::Mat>());
+  tests.assign(folds, std::vector<cv::Mat>());
+  labels.assign(folds, std::vector<uchar>());
+
+  for (size_t fold = 0; fold < folds; ++fold)
+  {
+    for (int digit = 0; digit < 9; ++digit)
+    {
+      for (size_t i = 0; i < images[digit].size(); ++i)
+      {
+        if (i % folds == fold)
+        {
+          tests[fold].push_back(images[digit][i]);
+          labels[fold].push_back(static_cast<uchar>(digit + 1));
+        }
+        else
+        {
+          training[fold * 9 + digit].push_back(images[digit][i]);
+        }
+      }
+    }
+  }
+}
+
+static double accuracy(const std::vector<Classification>& classifications, const std::vector<uchar>& labels)
+{
+  size_t correct = 0;
+  for (size_t i = 0; i < labels.size(); ++i)
+    if (classifications[i].label == labels[i])
+      ++correct;
+
+  return labels.empty() ? 0.0 : 100.0 * correct / labels.size();
+}
+
+// microseconds per query
+static double measureQueries(const DigitClassifier& classifier, const std::vector<cv::Mat>& queries)
+{
+  std::vector<Classification> classifications;
+  size_t runs = 0;
+  int64 startTicks = cv::getTickCount();
+  do
+  {
+    classifier.classifyBatch(queries, classifications);
+    ++runs;
+  }
+  while (elapsedMs(startTicks) < TUNE_LATENCY_SECONDS * 1000.0);
+
+  return elapsedMs(startTicks) * 1000.0 / (runs * queries.size());
+}
+
+// size of the classifier saved in the format the pipeline loads, 0 if it cannot be saved
+static size_t modelBytes(const DigitClassifier& classifier)
+{
+  std::stringstream filename;
+  filename << P_tmpdir << "/vsudoku-tune-" << getpid() << ".yml";
+  if (! classifier.save(filename.str()))
+    return 0;
+
+  std::ifstream file(filename.str().c_str(), std::ios::binary | std::ios::ate);
+  size_t bytes = file ? static_cast<size_t>(file.tellg()) : 0;
+  std::remove(filename.str().c_str());
+
+  return bytes;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argv[1][0] == '-')
+  {
+    printUsage();
+    return 1;
+  }
+
+  size_t folds = TUNE_FOLDS;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string saveFile;
+  std::vector<ClassifierBackend::Type> backends = {ClassifierBackend::BACKEND_KNN, ClassifierBackend::BACKEND_SVM,
+                                                   ClassifierBackend::BACKEND_NN};
+  std::vector<DigitFeatures::Type> featureTypes = {DigitFeatures::FEATURES_PIXELS, DigitFeatures::FEATURES_HOG};
+  std::vector<size_t> sampleWidths = {12, 16, 20};
+  std::vector<size_t> pcaComponents = {0, 32};
+  std::vector<size_t> ks = {1, 3, 5, 7};
+  std::vector<double> cs = {1.0, 10.0, 100.0};
+  std::vector<double> gammas = {0.005, 0.02, 0.08};
+
+  // every option takes a value
+  for (int i = 2; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    if (i + 1 >= argc)
+    {
+      printUsage();
+      return 1;
+    }
+
+    std::string value(argv[++i]);
+    bool valid = true;
+    if (arg == "--folds")
+      valid = (folds = std::max(0, std::atoi(value.c_str()))) >= 2;
+    else if (arg == "--threads")
+      valid = (threads = std::max(0, std::atoi(value.c_str()))) >= 1;
+    else if (arg == "--backends")
+      valid = parseBackends(value, backends);
+    else if (arg == "--features")
+      valid = parseFeatures(value, featureTypes);
+    else if (arg == "--widths")
+      valid = parseList(value, sampleWidths);
+    else if (arg == "--pca")
+      valid = parseList(value, pcaComponents);
+    else if (arg == "--k")
+      valid = parseList(value, ks);
+    else if (arg == "--c")
+      valid = parseList(value, cs);
+    else if (arg == "--gamma")
+      valid = parseList(value, gammas);
+    else if (arg == "--save")
+      saveFile = value;
+    else
+      valid = false;
+
+    if (! valid)
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  std::vector<cv::Mat> images[9];
+  if (! TrainingSet::load(argv[1], images))
+  {
+    std::cerr << "Cannot read training set " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<Configuration> configurations;
+  for (ClassifierBackend::Type backend : backends)
+  {
+    for (DigitFeatures::Type features : featureTypes)
+    {
+      for (size_t sampleWidth : sampleWidths)
+      {
+        for (size_t pca : pcaComponents)
+        {
+          Configuration configuration = {backend, features, sampleWidth, pca, KNN_K, 0.0, 0.0};
+          if (backend == ClassifierBackend::BACKEND_KNN)
+          {
+            for (size_t k : ks)
+            {
+              configuration.k = k;
+              configurations.push_back(configuration);
+            }
+          }
+          else if (backend == ClassifierBackend::BACKEND_SVM)
+          {
+            for (double c : cs)
+            {
+              for (double gamma : gammas)
+              {
+                configuration.c = c;
+                configuration.gamma = gamma;
+                configurations.push_back(configuration);
+              }
+            }
+          }
+          else
+          {
+            configurations.push_back(configuration);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<cv::Mat> > training, tests;
+  std::vector<std::vector<uchar> > labels;
+  splitFolds(images, folds, training, tests, labels);
+
+  SudokuFinder sudokuFinder(SUDOKU_CELL_WORKING_SIZE, DIRECT_CELL_SAMPLE_SIZE);
+  DigitExtractor extractor(sudokuFinder);
+
+  std::cerr << configurations.size() << " configurations, " << folds << "-fold cross validation on "
+            << TrainingSet::size(images) << " images with " << threads << " threads" << std::endl;
+
+  // every configuration and fold trains on its own thread, so OpenCV does not split them up any further
+  int openCVThreads = cv::getNumThreads();
+  cv::setNumThreads(0);
+
+  std::vector<Evaluation> evaluations(configurations.size());
+  for (Evaluation& evaluation : evaluations)
+    evaluation.accuracies.assign(folds, 0.0);
+
+  size_t jobCount = configurations.size() * folds;
+  std::atomic<size_t> nextJob(0);
+  std::atomic<size_t> doneJobs(0);
+  std::mutex evaluationMutex;
+  int64 startTicks = cv::getTickCount();
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      for (size_t job = nextJob++; job < jobCount; job = nextJob++)
+      {
+        size_t index = job / folds;
+        size_t fold = job % folds;
+
+        std::unique_ptr<DigitClassifier> classifier(configurations[index].create(extractor));
+        int64 trainTicks = cv::getTickCount();
+        classifier->train(&training[fold * 9]);
+        double trainMs = elapsedMs(trainTicks);
+
+        std::vector<Classification> classifications;
+        classifier->classifyBatch(tests[fold], classifications);
+        double foldAccuracy = accuracy(classifications, labels[fold]);
+
+        std::lock_guard<std::mutex> lock(evaluationMutex);
+        Evaluation& evaluation = evaluations[index];
+        evaluation.accuracies[fold] = foldAccuracy;
+        evaluation.trainMs += trainMs / folds;
+        if (fold == 0)
+          evaluation.classifier = std::move(classifier);
+
+        std::cerr << "\r" << ++doneJobs << " / " << jobCount << " trained" << std::flush;
+      }
+    }));
+  }
+
+  for (std::thread& worker : workers)
+    worker.join();
+
+  cv::setNumThreads(openCVThreads);
+  std::cerr << " in " << elapsedMs(startTicks) / 1000.0 << " s" << std::endl;
+
+  // a grid worth of cells, taken evenly from all digits
+  std::vector<cv::Mat> queries;
+  for (size_t i = 0; queries.size() < NUM_ROWS_CELLS * NUM_ROWS_CELLS; ++i)
+  {
+    const std::vector<cv::Mat>& digitImages = images[i % 9];
+    queries.push_back(digitImages[(i / 9) % digitImages.size()]);
+  }
+
+  // latencies are measured one configuration at a time with all cores, like in the pipeline
+  for (Evaluation& evaluation : evaluations)
+  {
+    evaluation.modelBytes = modelBytes(*evaluation.classifier);
+    evaluation.queryUs = measureQueries(*evaluation.classifier, queries);
+    evaluation.classifier.reset();
+  }
+
+  std::vector<size_t> order(configurations.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(std::begin(order), std::end(order), [&](size_t a, size_t b)
+  {
+    return evaluations[a].meanAccuracy() > evaluations[b].meanAccuracy();
+  });
+
+  std::cout << std::setw(8) << "backend" << std::setw(9) << "features" << std::setw(7) << "width"
+            << std::setw(5) << "pca" << std::setw(22) << "parameters" << std::setw(11) << "accuracy"
+            << std::setw(8) << "+/-" << std::setw(11) << "train ms" << std::setw(10) << "size KB"
+            << std::setw(10) << "query us" << std::endl;
+
+  std::cout << std::fixed;
+  for (size_t index : order)
+  {
+    const Configuration& configuration = configurations[index];
+    const Evaluation& evaluation = evaluations[index];
+    std::cout << std::setw(8) << ClassifierBackend::name(configuration.backend)
+              << std::setw(9) << DigitFeatures::name(configuration.features)
+              << std::setw(7) << configuration.sampleWidth << std::setw(5) << configuration.pcaComponents
+              << std::setw(22) << configuration.parameters()
+              << std::setprecision(2) << std::setw(10) << evaluation.meanAccuracy() << "%"
+              << std::setw(8) << evaluation.accuracyDeviation()
+              << std::setprecision(0) << std::setw(11) << evaluation.trainMs
+              << std::setw(10) << (evaluation.modelBytes + 512) / 1024
+              << std::setprecision(1) << std::setw(10) << evaluation.queryUs << std::endl;
+  }
+
+  if (saveFile.empty() || order.empty())
+    return 0;
+
+  const Configuration& best = configurations[order.front()];
+  std::unique_ptr<DigitClassifier> classifier(best.create(extractor));
+  classifier->train(images);
+  if (! classifier->save(saveFile))
+  {
+    std::cerr << "Cannot save classifier " << saveFile << std::endl;
+    return 1;
+  }
+
+  std::cerr << "Saved the " << ClassifierBackend::name(best.backend) << " classifier trained on the whole set to "
+            << saveFile << ", load it with --backend " << ClassifierBackend::name(best.backend) << std::endl;
+  return 0;
+}
@@ -24,7 +24,7 @@
 
 #include <vector>
 
-MainWindow::MainWindow(QWidget *parent) :
+MainWindow::MainWindow(FrameSource *frameSource, QWidget *parent) :
   QMainWindow(parent),
   ui(new Ui::MainWindow),
   _consoleLock()
@@ -40,7 +40,7 @@ MainWindow::MainWindow(QWidget *parent) :
   setupSudokuGrid();
   this->adjustSize();
 
-  _processThread = new ProcessThread(this);
+  _processThread = new ProcessThread(this, frameSource);
   qRegisterMetaType<size_t>("size_t");
   connect(_processThread, SIGNAL(newFrame(QImage)), this, SLOT(updateCamView(QImage)));
   connect(_processThread, SIGNAL(digitChanged(size_t,size_t,uchar)), this, SLOT(updateSudokuView(size_t,size_t,uchar)));
@@ -2,36 +2,22 @@
 
 #include "../../include/gui/mainwindow.hpp"
 #include "../../include/settings.hpp"
+#include "../../include/pipeline/stagedpipeline.hpp"
 #include "../../include/utils/qtopencv.hpp"
-#include "../../include/utils/drawutils.hpp"
-#include "../../include/classification/knndigitclassifier.hpp"
-#include "../../include/classification/svmdigitclassifier.hpp"
-#include "../../include/classification/nndigitclassifier.hpp"
 
-#include <QMutexLocker>
 #include <QTextBlock>
 #include <QTextCursor>
 
-ProcessThread::ProcessThread(MainWindow *window) :
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <sstream>
+
+ProcessThread::ProcessThread(MainWindow *window, FrameSource *frameSource) :
   _mainWindow(window),
-  _sudokuFinder(SUDOKU_CELL_WORKING_SIZE),
-  _digitExtractor(_sudokuFinder),
   _running(true),
-  _classify(false),
-  _videoCapture(CAM_NUM),
-  _extractorFinderMutex(),
-  _classifierMutex()
+  _pipeline(),
+  _frameSource(frameSource)
 {
-#ifdef USE_KNN_CLASSIFIER
-    _digitClassifier = new KNNDigitClassifier(_digitExtractor, DIGIT_SAMPLE_WIDTH, KNN_K, PCA_COMPONENTS);
-#elif defined USE_SVM_CLASSIFIER
-    _digitClassifier = new SVMDigitClassifier(_digitExtractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
-#else
-    _digitClassifier = new NNDigitClassifier(_digitExtractor, DIGIT_SAMPLE_WIDTH, PCA_COMPONENTS);
-#endif
-
-    setupResponses();
-
     // needed to prevent QT warnings. No idea where they come from...
     qRegisterMetaType<QTextBlock>("QTextBlock");
     qRegisterMetaType<QTextCursor>("QTextCursor");
@@ -39,70 +25,50 @@ ProcessThread::ProcessThread(MainWindow *window) :
 
 ProcessThread::~ProcessThread()
 {
-  delete _digitClassifier;
+  delete _frameSource;
 }
 
 bool ProcessThread::containsDigit(size_t row, size_t col)
 {
-  QMutexLocker lock(&_extractorFinderMutex);
-  return _digitExtractor.containsDigit(row, col);
+  return _pipeline.containsDigit(row, col);
 }
 
 QImage ProcessThread::getDigitCell(size_t row, size_t col)
 {
-  QMutexLocker lock(&_extractorFinderMutex);
-
   cv::Mat cell;
-  if (! _sudokuFinder.cell(row, col, cell))
-    return QImage(_sudokuFinder.getCellSize(), _sudokuFinder.getCellSize(), QImage::Format_RGB888);
+  if (! _pipeline.cell(row, col, cell))
+    return QImage(_pipeline.getCellSize(), _pipeline.getCellSize(), QImage::Format_RGB888);
 
   return QtOpenCV::MatToQImage(cell, QImage::Format_RGB888).copy();
 }
 
 QImage ProcessThread::getPreparedDigitCell(size_t row, size_t col)
 {
-  QMutexLocker lock(&_extractorFinderMutex);
-
   cv::Mat cell;
-  if (! _digitExtractor.cell(row, col, cell))
-    return QImage(_sudokuFinder.getCellSize(), _sudokuFinder.getCellSize(), QImage::Format_Indexed8);
+  if (! _pipeline.preparedCell(row, col, cell))
+    return QImage(_pipeline.getCellSize(), _pipeline.getCellSize(), QImage::Format_Indexed8);
 
   return QtOpenCV::MatToQImage(cell, QImage::Format_Indexed8).copy();
 }
 
 uchar ProcessThread::getDigit(size_t row, size_t col)
 {
-  QMutexLocker lock1(&_extractorFinderMutex);
-
-  cv::Mat cell;
-  bool foundCell = _sudokuFinder.cell(row, col, cell);
-
-  if (! _classify || ! foundCell)
-    return NO_DIGIT_FOUND;
-
-  QMutexLocker lock2(&_classifierMutex);
-  return _digitClassifier->classify(cell);
+  return _pipeline.getDigit(row, col);
 }
 
 void ProcessThread::train(const std::vector<cv::Mat> *trainingImages)
 {
-  QMutexLocker lock1(&_extractorFinderMutex);
-  QMutexLocker lock2(&_classifierMutex);
-
-  _digitClassifier->train(trainingImages);
-  _classify = true;
+  _pipeline.train(trainingImages);
 }
 
 bool ProcessThread::loadClassifier(const QString &filename)
 {
-  QMutexLocker lock(&_classifierMutex);
-  return (_classify = _digitClassifier->load(qPrintable(filename)));
+  return _pipeline.loadClassifier(qPrintable(filename));
 }
 
 bool ProcessThread::saveClassifier(const QString &filename)
 {
-  QMutexLocker lock(&_classifierMutex);
-  return _digitClassifier->save(qPrintable(filename));
+  return _pipeline.saveClassifier(qPrintable(filename));
 }
 
 void ProcessThread::stop()
@@ -111,132 +77,83 @@ void ProcessThread::stop()
   _running = false;
 }
 
-void ProcessThread::setupResponses()
-{
-  _responseCount = 0;
-  _allFixed = false;
-  _fixedSent = false;
-  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
-  {
-    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
-    {
-      _digitFixed[row][col] = false;
-      for (size_t i = 0; i < NUM_FRAMES_FIXED; ++i)
-        _digitResponses[row][col][i] = i;
-    }
-  }
-}
-
 void ProcessThread::run()
 {
-  if (! _videoCapture.isOpened())
+  if (! _frameSource->isOpened())
   {
-    _mainWindow->printOnConsole("Could not open cam!");
+    _mainWindow->printOnConsole(QString("Could not open ") + _frameSource->description().c_str() + "!");
     return;
   }
 
-  _mainWindow->printOnConsole("Application running...");
+  _mainWindow->printOnConsole(QString("Application running on ") + _frameSource->description().c_str() + "...");
 
-  _found = false;
-  _lostCount = 0;
+  StagedPipeline stagedPipeline(_pipeline, *_frameSource);
+  int64 startTicks = cv::getTickCount();
 
-  while (_running)
+  stagedPipeline.start([this](const PipelineFrame& frame)
   {
-    if (! _videoCapture.grab())
-    {
-      _mainWindow->printOnConsole("No picture from cam! Stop capturing...");
-      return;
-    }
-
-    cv::Mat frame, frameRGB;
-    _videoCapture >> frame;
-
-    QMutexLocker extractorLock(&_extractorFinderMutex);
-
-    if (_sudokuFinder.updateFrame(frame))
-    {
-      _lostCount = 0;
-      if (! _found)
-      {
-        _found = true;
-        emit sudokuAppeared();
-      }
-
-      frame = _sudokuFinder.getFrame();
-      const Color &frameColor = _allFixed ? DrawUtils::COLOR_GREEN : DrawUtils::COLOR_RED;
-      DrawUtils::drawContour(frame, _sudokuFinder.getFoundSudokuContour(), frameColor, 3);
-
-      _digitExtractor.updateCells();
-
-      if (_classify)
-      {
-        QMutexLocker classifierLock(&_classifierMutex);
-        classifyDigits();
-      }
-    }
-    else if (++_lostCount == NUM_FRAMES_LOST)
-    {
-      _found = false;
-      _lostCount = 0;
-      setupResponses();
-      _sudokuFinder.unshowSolution();
-      emit sudokuDisappeared();
-    }
+    emitResult(frame.result);
 
-    cv::cvtColor(frame, frameRGB, CV_BGR2RGB);
+    cv::Mat frameRGB;
+    cv::cvtColor(frame.frame, frameRGB, CV_BGR2RGB);
     QImage qFrame = QtOpenCV::MatToQImage(frameRGB, QImage::Format_RGB888);
     emit newFrame(qFrame.copy());
+  });
 
-    QThread::msleep(20);
+  while (_running && stagedPipeline.isRunning())
+    QThread::msleep(FRAME_DELAY_MS);
+
+  stagedPipeline.stop();
+  stagedPipeline.wait();
+
+  if (_running)
+  {
+    if (_frameSource->isLive())
+      _mainWindow->printOnConsole("No picture from cam! Stop capturing...");
+    else
+      _mainWindow->printOnConsole("End of input reached.");
   }
 
+  size_t frameCount = stagedPipeline.renderedFrames();
+  double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+  std::stringstream ss;
+  ss << "Processed " << frameCount << " frames in " << seconds << " s";
+  if (seconds > 0.0)
+    ss << " (" << frameCount / seconds << " fps)";
+  ss << ", " << stagedPipeline.droppedFrames() << " frames dropped";
+  ss << ", latency " << stagedPipeline.meanLatencyMs() << " ms mean, " << stagedPipeline.maxLatencyMs() << " ms max";
+  ss << ", " << _pipeline.skipRatio() * 100.0 << " % of frames tracked or reused";
+  ss << ", " << _pipeline.cacheHitRate() * 100.0 << " % of cells taken from the classification cache";
+  ss << ", digits fixed after " << _pipeline.meanFramesToLock() << " frames on average";
+  if (_pipeline.classifierBackend() == ClassifierBackend::BACKEND_CASCADE)
+    ss << ", " << _pipeline.escalationRate() * 100.0 << " % of digits passed on to the SVM";
+  _mainWindow->printOnConsole(ss.str().c_str());
+
   QThread::currentThread()->quit();
 }
 
-void ProcessThread::classifyDigits()
+void ProcessThread::emitResult(const PipelineResult& result)
 {
-  _allFixed = true;
+  // a merged result may hold a disappearance and the next appearance
+  if (result.disappeared)
+    emit sudokuDisappeared();
+
+  if (result.appeared)
+    emit sudokuAppeared();
+
   for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
   {
     for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
     {
-      if (_digitFixed[row][col])
-        continue;
-
-      uchar digit = NO_DIGIT_FOUND;
-
-      cv::Mat cell;
-      if (_sudokuFinder.cell(row, col, cell) && _digitExtractor.containsDigit(row, col))
-        digit = _digitClassifier->classify(cell);
-
-      emit digitChanged(row, col, digit);
-
-      _digitResponses[row][col][_responseCount] = digit;
-      bool fix = true;
-      for (size_t i = 0; i < NUM_FRAMES_FIXED && fix; ++i)
-        if (digit != _digitResponses[row][col][i])
-          fix = false;
-      if (fix)
-      {
-        _digitFixed[row][col] = true;
-        emit digitFixed(row, col, digit);
-      }
-      else
-      {
-        _allFixed = false;
-        _fixedSent = false;
-      }
+      if (result.updated[row][col])
+        emit digitChanged(row, col, result.digits[row][col]);
+      if (result.newlyFixed[row][col])
+        emit digitFixed(row, col, result.digits[row][col]);
     }
   }
 
-  if (++_responseCount == NUM_FRAMES_FIXED)
-    _responseCount = 0;
-
-  if (_allFixed && ! _fixedSent)
-  {
-    _fixedSent = true;
+  if (result.allDigitsFixed)
     emit allDigitsFixed();
-  }
 }
 
 void ProcessThread::setSolution(uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS])
@@ -246,6 +163,5 @@ void ProcessThread::setSolution(uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS])
 
 void ProcessThread::showSolvedSudoku()
 {
-  QMutexLocker finderLock(&_extractorFinderMutex);
-  _sudokuFinder.showSolution(_solution);
+  _pipeline.showSolution(_solution);
 }
@@ -1,24 +1,52 @@
 #include "../../include/imgproc/digitextractor.hpp"
 #include "../../include/utils/drawutils.hpp"
+#include "../../include/utils/parallelutils.hpp"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #define THRESHOLD_C 10
 #define THRESHOLD_SIZE 9
 
 DigitExtractor::DigitExtractor(const SudokuFinder& sudokuFinder)
   : _sudokuFinder(sudokuFinder),
-    _prepared(false)
+    _prepared(false),
+    _rectificationId(0),
+    _fusedNormalization(FUSED_DIGIT_NORMALIZATION)
 {
-  _thresholdKSize = _sudokuFinder.getCellSize();
-  if (_thresholdKSize % 2 == 0)
-    ++_thresholdKSize;
+  resetEmptyCells();
+}
 
-  int cellSize = _sudokuFinder.getCellSize();
+cv::Rect DigitExtractor::searchRegion(int cellSize) const
+{
+  return cv::Rect(cellSize / 3, cellSize / 3, cellSize / 3, cellSize / 3);
+}
+
+cv::Rect DigitExtractor::emptyCheckRegion(int cellSize) const
+{
+  return cv::Rect(cellSize / 4, cellSize / 4, cellSize / 2, cellSize / 2);
+}
 
-  _searchRegion = cv::Rect(cellSize / 3, cellSize / 3,
-                           cellSize / 3, cellSize / 3);
+int DigitExtractor::thresholdSize(int cellSize) const
+{
+  // THRESHOLD_SIZE fits cells of the working size, the block size has to stay odd
+  int size = static_cast<int>(THRESHOLD_SIZE * cellSize / static_cast<double>(SUDOKU_CELL_WORKING_SIZE) + 0.5);
+  return std::max(3, size | 1);
+}
+
+void DigitExtractor::setFusedNormalization(bool fused)
+{
+  _fusedNormalization = fused;
+  _prepared = false;
+}
+
+bool DigitExtractor::fusedNormalization() const
+{
+  return _fusedNormalization;
 }
 
 bool DigitExtractor::containsDigit(size_t row, size_t col) const
@@ -45,14 +73,65 @@ bool DigitExtractor::cell(size_t row, size_t col, cv::Mat& cell) const
   return true;
 }
 
+bool DigitExtractor::digit(size_t row, size_t col, cv::Mat& digit) const
+{
+  if (row >= NUM_ROWS_CELLS || col >= NUM_ROWS_CELLS || ! _prepared)
+    return false;
+
+  digit = _digits[row][col](_boundingBoxes[row][col]);
+
+  return true;
+}
+
+bool DigitExtractor::digit(size_t row, size_t col, const cv::Size& size, cv::Mat& sample) const
+{
+  if (row >= NUM_ROWS_CELLS || col >= NUM_ROWS_CELLS || ! _prepared)
+    return false;
+
+  scaleDigit(_digits[row][col], _boundingBoxes[row][col], _masks[row][col],
+             _normalizations[row][col], size, sample);
+
+  return true;
+}
+
 bool DigitExtractor::updateCells()
 {
+  // the digits were already extracted from this rectification
+  if (_prepared && _sudokuFinder.getRectificationId() == _rectificationId)
+    return true;
+
   _prepared = true;
+  _rectificationId = _sudokuFinder.getRectificationId();
 
-  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
-    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
-      if (! (_prepared = updateCell(row, col)))
-        return false;
+  // one integral image serves the empty cell check of all cells
+  const cv::Mat& grid = _sudokuFinder.getRectifiedSudoku();
+  if (! _sudokuFinder.directCellSampling() && ! grid.empty())
+  {
+    cv::cvtColor(grid, _grayGrid, CV_BGR2GRAY);
+    cv::integral(_grayGrid, _gridSum, _gridSquaredSum, CV_64F);
+  }
+  else
+  {
+    _gridSum.release();
+    _gridSquaredSum.release();
+  }
+
+  // the cells are independent, each one only writes its own entries
+  bool updated[NUM_ROWS_CELLS * NUM_ROWS_CELLS];
+  ParallelUtils::parallelFor(NUM_ROWS_CELLS * NUM_ROWS_CELLS, [&](int i)
+  {
+    updated[i] = updateCell(i / NUM_ROWS_CELLS, i % NUM_ROWS_CELLS);
+  });
+
+  for (size_t i = 0; i < NUM_ROWS_CELLS * NUM_ROWS_CELLS; ++i)
+  {
+    if (! updated[i])
+    {
+      _prepared = false;
+      resetEmptyCells();
+      return false;
+    }
+  }
 
   return _prepared;
 }
@@ -66,35 +145,243 @@ bool DigitExtractor::updateCell(size_t row, size_t col)
   cv::Mat& digit = _digits[row][col] = cv::Mat::zeros(_sudokuFinder.getCellSize(),
                                                       _sudokuFinder.getCellSize(),
                                                       CV_8UC1);
+  _boundingBoxes[row][col] = cv::Rect(0, 0, digit.cols, digit.rows);
+  _masks[row][col].release();
+  _normalizations[row][col].release();
 
-  extractDigit(cell, digit);
+  if (! isEmptyCell(row, col, cell))
+    extractDigit(cell, digit, _boundingBoxes[row][col], _masks[row][col], _normalizations[row][col]);
 
   return true;
 }
 
+void DigitExtractor::reset()
+{
+  _prepared = false;
+  resetEmptyCells();
+}
+
+void DigitExtractor::resetEmptyCells()
+{
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      _emptyCells[row][col] = false;
+}
+
+bool DigitExtractor::isEmptyCell(size_t row, size_t col, const cv::Mat& cell)
+{
+  // hysteresis keeps the decision stable for cells close to the threshold
+  double stdDev = centerStdDev(row, col, cell);
+  bool& empty = _emptyCells[row][col];
+  empty = stdDev < (empty ? EMPTY_CELL_LEAVE_STDDEV : EMPTY_CELL_ENTER_STDDEV);
+  return empty;
+}
+
+double DigitExtractor::centerStdDev(size_t row, size_t col, const cv::Mat& cell) const
+{
+  int cellSize = _sudokuFinder.getCellSize();
+  cv::Rect region = emptyCheckRegion(cellSize);
+  if (_gridSum.empty())
+  {
+    cv::Mat center;
+    cv::cvtColor(cell(region), center, CV_BGR2GRAY);
+    cv::Scalar mean, stdDev;
+    cv::meanStdDev(center, mean, stdDev);
+    return stdDev[0];
+  }
+
+  int x0 = col * cellSize + region.x;
+  int y0 = row * cellSize + region.y;
+  int x1 = x0 + region.width;
+  int y1 = y0 + region.height;
+
+  double n = region.area();
+  double sum = _gridSum.at<double>(y1, x1) - _gridSum.at<double>(y0, x1)
+             - _gridSum.at<double>(y1, x0) + _gridSum.at<double>(y0, x0);
+  double squaredSum = _gridSquaredSum.at<double>(y1, x1) - _gridSquaredSum.at<double>(y0, x1)
+                    - _gridSquaredSum.at<double>(y1, x0) + _gridSquaredSum.at<double>(y0, x0);
+
+  double mean = sum / n;
+  return std::sqrt(std::max(0.0, squaredSum / n - mean * mean));
+}
+
 void DigitExtractor::extractDigit(const cv::Mat& src, cv::Mat& digit) const
 {
-  cv::Mat cell = src.clone();
-  cv::cvtColor(cell, cell, CV_BGR2GRAY);
+  cv::Rect boundingBox;
+  extractDigit(src, digit, boundingBox);
+}
 
-  cv::adaptiveThreshold(cell, cell, 255, cv::ADAPTIVE_THRESH_MEAN_C,
-                        cv::THRESH_BINARY_INV, THRESHOLD_SIZE, THRESHOLD_C);
+void DigitExtractor::extractDigit(const cv::Mat& src, cv::Mat& digit, cv::Rect& boundingBox) const
+{
+  cv::Mat mask, normalization;
+  extractDigit(src, digit, boundingBox, mask, normalization);
+}
 
-  digit = cv::Mat::zeros(src.rows, src.cols, CV_8UC1);
-  cv::Mat startPixel = cell(_searchRegion).clone();
-  floodExtract(cell, digit, startPixel, _searchRegion);
+void DigitExtractor::extractDigit(const cv::Mat& src, const cv::Size& size, cv::Mat& sample) const
+{
+  cv::Mat mask;
+  extractMask(src, mask);
 
-  if (containsDigit(digit))
+  if (! _fusedNormalization || ! containsDigit(mask))
   {
+    cv::Mat& digit = mask;
+    if (containsDigit(digit))
+    {
+      deskew(digit);
+      moveToCenter(digit);
+    }
+    scaleDigit(digit, boundingBox(digit), cv::Mat(), cv::Mat(), size, sample);
+    return;
+  }
+
+  // only the mask and the map are needed, the normalized digit is resampled at the sample size
+  cv::Mat normalization = this->normalization(mask);
+  scaleDigit(cv::Mat(), normalizedBoundingBox(mask, normalization), mask, normalization, size, sample);
+}
+
+void DigitExtractor::extractDigit(const cv::Mat& src, cv::Mat& digit, cv::Rect& boundingBox,
+                                  cv::Mat& mask, cv::Mat& normalization) const
+{
+  extractMask(src, mask);
+  normalization.release();
+
+  if (! containsDigit(mask))
+  {
+    digit = mask;
+  }
+  else if (_fusedNormalization)
+  {
+    // the bounding box follows from the map, so the digit is scaled straight from the mask later
+    normalization = this->normalization(mask);
+    cv::warpAffine(mask, digit, normalization, mask.size(),
+                   cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+    boundingBox = normalizedBoundingBox(mask, normalization);
+    return;
+  }
+  else
+  {
+    // the mask is only kept for the fused normalization
+    digit = mask;
+    mask.release();
     deskew(digit);
     moveToCenter(digit);
   }
+
+  boundingBox = this->boundingBox(digit);
+}
+
+void DigitExtractor::extractMask(const cv::Mat& src, cv::Mat& mask) const
+{
+  // cells are extracted in parallel, so every thread keeps its own buffers
+  static thread_local cv::Mat gray, cell;
+  cv::cvtColor(src, gray, CV_BGR2GRAY);
+
+  // training images and cells sampled from the frame may differ in size
+  int cellSize = src.cols;
+  cv::adaptiveThreshold(gray, cell, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+                        cv::THRESH_BINARY_INV, thresholdSize(cellSize), THRESHOLD_C);
+
+  cv::Rect region = searchRegion(cellSize);
+  mask = cv::Mat::zeros(src.rows, src.cols, CV_8UC1);
+  floodExtract(cell, mask, cell(region), region);
+}
+
+void DigitExtractor::scaleDigit(const cv::Mat& digit, const cv::Rect& boundingBox, const cv::Mat& mask,
+                                const cv::Mat& normalization, const cv::Size& size, cv::Mat& sample) const
+{
+  if (normalization.empty())
+  {
+    cv::Mat crop = digit(boundingBox);
+    if (crop.size() == size)
+      crop.copyTo(sample);
+    else
+      cv::resize(crop, sample, size);
+    return;
+  }
+
+  // maps a sample pixel into the bounding box like cv::resize does and from there
+  // through the normalization into the mask
+  double s_x = static_cast<double>(boundingBox.width) / size.width;
+  double s_y = static_cast<double>(boundingBox.height) / size.height;
+  cv::Mat crop = (cv::Mat_<double>(3, 3) << s_x, 0.0, boundingBox.x + 0.5*s_x - 0.5,
+                                            0.0, s_y, boundingBox.y + 0.5*s_y - 0.5,
+                                            0.0, 0.0, 1.0);
+  cv::Mat map = normalization * crop;
+  cv::warpAffine(mask, sample, map, size, cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+}
+
+cv::Rect DigitExtractor::boundingBox(const cv::Mat& digit) const
+{
+  std::vector<cv::Point> points;
+  cv::findNonZero(digit, points);
+
+  if (points.size() > 1)
+    return cv::boundingRect(points);
+  else
+    return cv::Rect(0, 0, digit.cols, digit.rows);
+}
+
+void DigitExtractor::normalizeDigit(const cv::Mat& digit, cv::Mat& normalized, const cv::Size& size) const
+{
+  // scaled from the output size to the cell size, so the digit is resampled only once
+  double scale = static_cast<double>(digit.cols) / size.width;
+  cv::Mat outputToCell = (cv::Mat_<double>(3, 3) << scale, 0.0,   0.0,
+                                                    0.0,   scale, 0.0,
+                                                    0.0,   0.0,   1.0);
+  cv::Mat M = normalization(digit) * outputToCell;
+  cv::warpAffine(digit, normalized, M, size,
+                 cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+}
+
+cv::Mat DigitExtractor::normalization(const cv::Mat& mask) const
+{
+  // deskew and centering composed into a single inverse map
+  double cellSize = mask.cols;
+  cv::Moments moments = cv::moments(mask, true);
+  double skew = moments.mu02 != 0.0 ? moments.mu11 / moments.mu02 : 0.0;
+  double c_x = moments.m10 / moments.m00;
+  double c_y = moments.m01 / moments.m00;
+  return (cv::Mat_<double>(2, 3) << 1.0, skew, c_x - 0.5*cellSize*(1.0 + skew),
+                                    0.0, 1.0,  c_y - 0.5*cellSize);
+}
+
+cv::Rect DigitExtractor::normalizedBoundingBox(const cv::Mat& mask, const cv::Mat& normalization) const
+{
+  cv::Rect cellRect(0, 0, mask.cols, mask.rows);
+  std::vector<cv::Point> points;
+  cv::findNonZero(mask, points);
+  if (points.size() <= 1)
+    return cellRect;
+
+  cv::Mat forward;
+  cv::invertAffineTransform(normalization, forward);
+
+  std::vector<cv::Point2f> mapped;
+  cv::transform(std::vector<cv::Point2f>(std::begin(points), std::end(points)), mapped, forward);
+
+  // the interpolated digit is nonzero up to a pixel around the mapped pixels,
+  // so the box is rounded outwards like that of the warped digit
+  float x_min = mapped[0].x, x_max = mapped[0].x, y_min = mapped[0].y, y_max = mapped[0].y;
+  for (const cv::Point2f& p : mapped)
+  {
+    x_min = std::min(x_min, p.x);
+    x_max = std::max(x_max, p.x);
+    y_min = std::min(y_min, p.y);
+    y_max = std::max(y_max, p.y);
+  }
+
+  int x0 = static_cast<int>(std::floor(x_min)), y0 = static_cast<int>(std::floor(y_min));
+  int x1 = static_cast<int>(std::ceil(x_max)), y1 = static_cast<int>(std::ceil(y_max));
+  cv::Rect boundingBox = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1) & cellRect;
+  return boundingBox.area() > 0 ? boundingBox : cellRect;
 }
 
 void DigitExtractor::floodExtract(const cv::Mat& src, cv::Mat& dst,
                                   const cv::Mat& startPixel, const cv::Rect& startRect) const
 {
-  cv::Mat visited = cv::Mat::zeros(src.rows, src.cols, CV_8UC1);
+  static thread_local cv::Mat visited;
+  visited.create(src.rows, src.cols, CV_8UC1);
+  visited.setTo(0);
   for (int row = 0; row < startPixel.rows; ++row)
   {
     int y = startRect.y + row;
@@ -149,7 +436,7 @@ void DigitExtractor::floodExtract(const cv::Mat &src, cv::Mat &dst, cv::Mat &vis
 
 void DigitExtractor::deskew(cv::Mat& digit) const
 {
-  size_t cellSize = _sudokuFinder.getCellSize();
+  size_t cellSize = digit.cols;
   cv::Moments moments = cv::moments(digit, true);
   double skew = moments.mu11 / moments.mu02;
   double m[2][3] = {
@@ -163,7 +450,7 @@ void DigitExtractor::deskew(cv::Mat& digit) const
 
 void DigitExtractor::moveToCenter(cv::Mat& digit) const
 {
-  size_t cellSize = _sudokuFinder.getCellSize();
+  size_t cellSize = digit.cols;
   cv::Moments moments = cv::moments(digit, true);
   double c_x = moments.m10 / moments.m00 - cellSize / 2.0;
   double c_y = moments.m01 / moments.m00 - cellSize / 2.0;
@@ -7,7 +7,14 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
 
-SudokuFinder::SudokuFinder(size_t cell_size) : _frame(), 
+#include <algorithm>
+
+SudokuFinder::SudokuFinder(size_t cell_size, size_t cell_sample_size) : _found(false),
+                                               _unchanged(false),
+                                               _rectificationId(0),
+                                               _sceneChange(SCENE_CHANGED),
+                                               _frame(), 
+                                               _grayFrame(),
                                                _preparedFrame(),
                                                _rectifiedSudoku(),
                                                _transformedRect(),
@@ -15,6 +22,8 @@ SudokuFinder::SudokuFinder(size_t cell_size) : _frame(),
 {
   _cellSize = cell_size;
   _rectificationSize = cell_size * NUM_ROWS_CELLS;
+
+  setCellSampleSize(cell_sample_size);
   
   _transformedRect.push_back(cv::Point2f(0, 0));
   _transformedRect.push_back(cv::Point2f(_rectificationSize, 0));
@@ -32,7 +41,7 @@ SudokuFinder::~SudokuFinder()
 
 size_t SudokuFinder::getCellSize() const
 {
-  return _cellSize;
+  return _cellSampleSize;
 }
 
 size_t SudokuFinder::getRectificationSize() const
@@ -40,6 +49,82 @@ size_t SudokuFinder::getRectificationSize() const
   return _rectificationSize;
 }
 
+bool SudokuFinder::directCellSampling() const
+{
+  return _directCellSampling;
+}
+
+void SudokuFinder::setCellSampleSize(size_t cell_sample_size)
+{
+  _directCellSampling = cell_sample_size > 0;
+  _cellSampleSize = _directCellSampling ? cell_sample_size : _cellSize;
+
+  // the next frame is searched and rectified again, even if nothing moved
+  _sceneReference.release();
+  _previousPerspectiveRect.clear();
+}
+
+SudokuFinder::SceneChange SudokuFinder::getSceneChange() const
+{
+  return _sceneChange;
+}
+
+bool SudokuFinder::rectificationUnchanged() const
+{
+  return _found && _unchanged;
+}
+
+size_t SudokuFinder::getRectificationId() const
+{
+  return _rectificationId;
+}
+
+void SudokuFinder::copyResults(const SudokuFinder& other)
+{
+  _found = other._found;
+  _unchanged = other._unchanged;
+  _rectificationId = other._rectificationId;
+  _sceneChange = other._sceneChange;
+
+  _rectificationSize = other._rectificationSize;
+  _cellSize = other._cellSize;
+  _cellSampleSize = other._cellSampleSize;
+  _directCellSampling = other._directCellSampling;
+
+  _frame = other._frame;
+  _foundContour = other._foundContour;
+
+  // cell() only reads one of them
+  if (_directCellSampling)
+  {
+    _rectifiedSudoku.release();
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+        _cells[row][col] = other._cells[row][col];
+  }
+  else
+  {
+    _rectifiedSudoku = other._rectifiedSudoku;
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+        _cells[row][col].release();
+  }
+}
+
+void SudokuFinder::detach()
+{
+  // the rectification buffers are reused by the next frame, so copies must own them
+  if (! _directCellSampling)
+  {
+    _rectifiedSudoku = _rectifiedSudoku.clone();
+    return;
+  }
+
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      _cells[row][col] = _cells[row][col].clone();
+}
+
 const cv::Mat& SudokuFinder::getFrame() const
 {
   return _frame;
@@ -58,6 +143,7 @@ const Contour<int>& SudokuFinder::getFoundSudokuContour() const
 void SudokuFinder::showSolution(const uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS])
 {
   memcpy(_solution, solution, NUM_ROWS_CELLS*NUM_ROWS_CELLS);
+  renderSolution();
   _showSolution = true;
 }
 
@@ -71,6 +157,12 @@ bool SudokuFinder::cell(size_t row, size_t col, cv::Mat& cell) const
   if (row >= NUM_ROWS_CELLS || col >= NUM_ROWS_CELLS || ! _found)
     return false;
   
+  if (_directCellSampling)
+  {
+    _cells[row][col].copyTo(cell);
+    return true;
+  }
+
   cv::Rect roi(col * _cellSize, row * _cellSize, _cellSize, _cellSize);
   _rectifiedSudoku(roi).copyTo(cell);
   
@@ -80,17 +172,43 @@ bool SudokuFinder::cell(size_t row, size_t col, cv::Mat& cell) const
 
 bool SudokuFinder::updateFrame(const cv::Mat& frame)
 {
-  _found = false;
-  
   _frame = frame.clone();
+
+  if ((_sceneChange = detectSceneChange()) == SCENE_STATIC)
+  {
+    // nothing moved, the last detection and rectification still hold
+    _unchanged = _found;
+    if (_found && _showSolution)
+      transformSolutionToFrame();
+    return _found;
+  }
+
+  cv::Rect frameRect(0, 0, _frame.cols, _frame.rows);
+  cv::Rect roi = _sceneChange == SCENE_MOVED && _found ? trackingRoi() : frameRect;
+
+  _found = false;
+  _unchanged = false;
   
   _foundContour.clear();
   _perspectiveRect.clear();
   
-  prepareFrame();
-  
-  if (! (_found = findSudoku()))
+  cv::cvtColor(_frame, _grayFrame, CV_BGR2GRAY);
+  prepareFrame(roi);
+  _found = findSudoku(roi.tl());
+
+  // the grid left the tracked region, so search the whole frame
+  if (! _found && roi != frameRect)
+  {
+    _sceneChange = SCENE_CHANGED;
+    prepareFrame(frameRect);
+    _found = findSudoku(cv::Point());
+  }
+
+  if (! _found)
+  {
+    _previousPerspectiveRect.clear();
     return false;
+  }
   
   transformSudoku();
 
@@ -100,9 +218,41 @@ bool SudokuFinder::updateFrame(const cv::Mat& frame)
   return true;
 }
 
-void SudokuFinder::transformSolutionToFrame()
+SudokuFinder::SceneChange SudokuFinder::detectSceneChange()
 {
-  cv::Mat solutionMat = cv::Mat::ones(_rectificationSize, _rectificationSize, CV_8UC3);
+  int height = std::max(1, _frame.rows * SCENE_THUMBNAIL_WIDTH / std::max(1, _frame.cols));
+  cv::resize(_frame, _sceneThumbnail, cv::Size(SCENE_THUMBNAIL_WIDTH, height), 0, 0, cv::INTER_AREA);
+  cv::cvtColor(_sceneThumbnail, _sceneThumbnail, CV_BGR2GRAY);
+
+  double diff = -1.0;
+  if (! _sceneReference.empty() && _sceneReference.size() == _sceneThumbnail.size())
+    diff = cv::norm(_sceneThumbnail, _sceneReference, cv::NORM_L1) / _sceneThumbnail.total();
+
+  // the reference stays until processing happens, so slow drift still adds up
+  if (diff >= 0.0 && diff <= MAX_STATIC_SCENE_DIFF)
+    return SCENE_STATIC;
+
+  std::swap(_sceneReference, _sceneThumbnail);
+
+  if (diff >= 0.0 && diff <= MAX_TRACKING_SCENE_DIFF)
+    return SCENE_MOVED;
+
+  return SCENE_CHANGED;
+}
+
+cv::Rect SudokuFinder::trackingRoi() const
+{
+  cv::Rect roi = cv::boundingRect(_foundContour);
+  int marginX = roi.width * TRACKING_ROI_MARGIN + 1;
+  int marginY = roi.height * TRACKING_ROI_MARGIN + 1;
+
+  roi = cv::Rect(roi.x - marginX, roi.y - marginY, roi.width + 2*marginX, roi.height + 2*marginY);
+  return roi & cv::Rect(0, 0, _frame.cols, _frame.rows);
+}
+
+void SudokuFinder::renderSolution()
+{
+  _solutionMat = cv::Mat::zeros(_rectificationSize, _rectificationSize, CV_8UC3);
   for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
   {
     for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
@@ -114,28 +264,107 @@ void SudokuFinder::transformSolutionToFrame()
         ss << (int) response;
 
         cv::Point p(col * SUDOKU_CELL_WORKING_SIZE + 5, row * SUDOKU_CELL_WORKING_SIZE + SUDOKU_CELL_WORKING_SIZE-5);
-        cv::putText(solutionMat, ss.str(), p, CV_FONT_HERSHEY_PLAIN, 2.2, DrawUtils::COLOR_GREEN);
+        cv::putText(_solutionMat, ss.str(), p, CV_FONT_HERSHEY_PLAIN, 2.2, DrawUtils::COLOR_GREEN);
       }
     }
   }
-  cv::Mat digitFrame = _frame.clone();
-  cv::warpPerspective(solutionMat, digitFrame, _homography, _frame.size(), cv::WARP_INVERSE_MAP);
-  cv::Mat digitFrameMask;
-  cv::cvtColor(digitFrame, digitFrameMask, CV_BGR2GRAY);
-  cv::threshold(digitFrameMask, digitFrameMask, 100, 255, CV_THRESH_BINARY);
-  digitFrame.copyTo(_frame, digitFrameMask);
+
+  cv::cvtColor(_solutionMat, _solutionMask, CV_BGR2GRAY);
+  cv::threshold(_solutionMask, _solutionMask, 100, 255, CV_THRESH_BINARY);
+}
+
+void SudokuFinder::transformSolutionToFrame()
+{
+  overlaySolution(_solutionMat, _solutionMask, _homography, _perspectiveRect, _frame);
+}
+
+void SudokuFinder::overlaySolution(const cv::Mat& solution, const cv::Mat& solutionMask,
+                                   const cv::Mat& homography, const Contour<float>& corners, cv::Mat& frame)
+{
+  // only the bounding box of the projected grid can receive solution digits
+  cv::Rect roi = cv::boundingRect(corners) & cv::Rect(0, 0, frame.cols, frame.rows);
+  if (roi.area() == 0)
+    return;
+
+  // the homography maps frame to rectified coordinates, so shift the roi back into the frame first
+  cv::Mat shift = (cv::Mat_<double>(3, 3) << 1.0, 0.0, roi.x,
+                                             0.0, 1.0, roi.y,
+                                             0.0, 0.0, 1.0);
+  cv::Mat roiHomography = homography * shift;
+
+  static thread_local cv::Mat solutionRoi, solutionRoiMask;
+  cv::warpPerspective(solution, solutionRoi, roiHomography, roi.size(),
+                      cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+  cv::warpPerspective(solutionMask, solutionRoiMask, roiHomography, roi.size(),
+                      cv::WARP_INVERSE_MAP | cv::INTER_NEAREST);
+
+  cv::Mat frameRoi = frame(roi);
+  solutionRoi.copyTo(frameRoi, solutionRoiMask);
 }
 
 void SudokuFinder::transformSudoku()
 {
+  // keep the previous rectification if neither the corners nor the grid content moved
+  if ((_unchanged = isStationary()))
+    return;
+
+  ++_rectificationId;
   _homography = cv::findHomography(_perspectiveRect, _transformedRect, 0);
-  cv::warpPerspective(_frame, _rectifiedSudoku, _homography, cv::Size2f(_rectificationSize, _rectificationSize));
+  if (_directCellSampling)
+    sampleCells();
+  else
+    cv::warpPerspective(_frame, _rectifiedSudoku, _homography, cv::Size2f(_rectificationSize, _rectificationSize));
+
+  _previousPerspectiveRect = _perspectiveRect;
+  _previousQuadRect = cv::boundingRect(_perspectiveRect) & cv::Rect(0, 0, _frame.cols, _frame.rows);
+  _grayFrame(_previousQuadRect).copyTo(_previousQuadContent);
+}
+
+void SudokuFinder::sampleCells()
+{
+  // maps rectified grid coordinates back into the frame
+  cv::Mat inverseHomography = _homography.inv();
+  double scale = static_cast<double>(_cellSize) / _cellSampleSize;
+
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      // scales a sample pixel up to the cell size and moves it to the cell's origin in the grid
+      cv::Mat cellToGrid = (cv::Mat_<double>(3, 3) << scale, 0.0,   static_cast<double>(col * _cellSize),
+                                                       0.0,   scale, static_cast<double>(row * _cellSize),
+                                                       0.0,   0.0,   1.0);
+      cv::warpPerspective(_frame, _cells[row][col], inverseHomography * cellToGrid,
+                          cv::Size(_cellSampleSize, _cellSampleSize),
+                          cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+    }
+  }
+}
+
+bool SudokuFinder::isStationary() const
+{
+  if (_previousPerspectiveRect.size() != _perspectiveRect.size() || _homography.empty())
+    return false;
+
+  for (size_t i = 0; i < _perspectiveRect.size(); ++i)
+  {
+    cv::Point2f shift = _perspectiveRect[i] - _previousPerspectiveRect[i];
+    if (shift.dot(shift) > MAX_STATIONARY_CORNER_SHIFT * MAX_STATIONARY_CORNER_SHIFT)
+      return false;
+  }
+
+  if (_previousQuadRect.area() == 0
+      || (_previousQuadRect & cv::Rect(0, 0, _grayFrame.cols, _grayFrame.rows)) != _previousQuadRect)
+    return false;
+
+  double diff = cv::norm(_grayFrame(_previousQuadRect), _previousQuadContent, cv::NORM_L1);
+  return diff <= MAX_STATIONARY_MEAN_DIFF * _previousQuadRect.area();
 }
 
-bool SudokuFinder::findSudoku()
+bool SudokuFinder::findSudoku(const cv::Point& offset)
 {
   std::vector<Contour<int>> contours;
-  cv::findContours(_preparedFrame, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
+  cv::findContours(_preparedFrame, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE, offset);
   
   if (contours.empty())
     return false;
@@ -180,9 +409,8 @@ bool SudokuFinder::findSudoku()
   
   return true;
 }
-void SudokuFinder::prepareFrame()
+void SudokuFinder::prepareFrame(const cv::Rect& roi)
 {
-  cv::cvtColor(_frame, _preparedFrame, CV_BGR2GRAY);
-  cv::blur(_preparedFrame, _preparedFrame, cv::Size(3, 3));
+  cv::blur(_grayFrame(roi), _preparedFrame, cv::Size(3, 3));
   cv::Canny(_preparedFrame, _preparedFrame, CANNY_LOW, CANNY_HIGH);
 }
@@ -1,11 +1,36 @@
 #include <QApplication>
 
 #include "include/gui/mainwindow.hpp"
+#include "include/capture/framesource.hpp"
+#include "include/settings.hpp"
+
+#include <string>
 
 int main(int argc, char **argv) {
   QApplication app(argc, argv);
 
-  MainWindow *window = new MainWindow;
+  // usage: vsudoku [--fast] [camera number | video file | image directory]
+  std::string location;
+  bool fast = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg(argv[i]);
+    if (arg == "--fast")
+      fast = true;
+    else
+      location = arg;
+  }
+
+  // the camera goes through FrameSource::open as well, so it is read on its own thread
+  if (location.empty())
+    location = std::to_string(CAM_NUM);
+
+  FrameSource *frameSource = FrameSource::open(location, FrameSource::PACING_REALTIME);
+
+  if (fast)
+    frameSource->setPacing(FrameSource::PACING_AS_FAST_AS_POSSIBLE);
+
+  MainWindow *window = new MainWindow(frameSource);
   QObject::connect(&app, SIGNAL(aboutToQuit()), window, SLOT(closing()));
   window->show();
 
@@ -0,0 +1,31 @@
+#include "../../include/pipeline/digitvoter.hpp"
+#include "../../include/pipeline/exactdigitvoter.hpp"
+#include "../../include/pipeline/likelihooddigitvoter.hpp"
+
+DigitVoter::DigitVoter()
+  : _frames(0)
+{
+}
+
+DigitVoter::~DigitVoter()
+{
+}
+
+void DigitVoter::reset()
+{
+  _frames = 0;
+}
+
+size_t DigitVoter::frames() const
+{
+  return _frames;
+}
+
+DigitVoter* DigitVoter::create()
+{
+#if LIKELIHOOD_VOTING
+  return new LikelihoodDigitVoter();
+#else
+  return new ExactDigitVoter();
+#endif
+}
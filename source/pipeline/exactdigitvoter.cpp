@@ -0,0 +1,50 @@
+#include "../../include/pipeline/exactdigitvoter.hpp"
+
+ExactDigitVoter::ExactDigitVoter()
+{
+  reset();
+}
+
+ExactDigitVoter::~ExactDigitVoter()
+{
+}
+
+void ExactDigitVoter::reset()
+{
+  DigitVoter::reset();
+
+  // distinct initial responses, so a digit needs NUM_FRAMES_FIXED real ones
+  _responseCount = 0;
+  for (size_t i = 0; i < NUM_FRAMES_FIXED; ++i)
+    _responses[i] = i;
+
+  _digit = NO_DIGIT_FOUND;
+  _votes = 0;
+}
+
+bool ExactDigitVoter::add(const Classification& classification, bool)
+{
+  ++_frames;
+
+  _digit = classification.label;
+  _responses[_responseCount] = _digit;
+  if (++_responseCount == NUM_FRAMES_FIXED)
+    _responseCount = 0;
+
+  _votes = 0;
+  for (size_t i = 0; i < NUM_FRAMES_FIXED; ++i)
+    if (_digit == _responses[i])
+      ++_votes;
+
+  return _votes == NUM_FRAMES_FIXED;
+}
+
+uchar ExactDigitVoter::digit() const
+{
+  return _digit;
+}
+
+float ExactDigitVoter::confidence() const
+{
+  return static_cast<float>(_votes) / NUM_FRAMES_FIXED;
+}
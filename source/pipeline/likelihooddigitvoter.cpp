@@ -0,0 +1,86 @@
+#include "../../include/pipeline/likelihooddigitvoter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+LikelihoodDigitVoter::LikelihoodDigitVoter()
+{
+  reset();
+}
+
+LikelihoodDigitVoter::~LikelihoodDigitVoter()
+{
+}
+
+void LikelihoodDigitVoter::reset()
+{
+  DigitVoter::reset();
+
+  std::fill(_logLikelihoods, _logLikelihoods + NUM_DIGITS + 1, 0.0);
+  _best = 0;
+  _second = 1;
+  _evidenceFrames = 0;
+  _label = NO_DIGIT_FOUND;
+  _repeats = 0;
+}
+
+bool LikelihoodDigitVoter::add(const Classification& classification, bool fresh)
+{
+  ++_frames;
+
+  _repeats = _frames > 1 && classification.label == _label ? _repeats + 1 : 1;
+  _label = classification.label;
+  // the first classification after a reset is evidence even if it was reused,
+  // a cell that looks like before would never collect any otherwise
+  if (! fresh && _evidenceFrames > 0)
+    return _repeats >= NUM_FRAMES_FIXED && digit() == _label;
+  ++_evidenceFrames;
+
+  // the empty cell check of the extractor is trusted up to VOTING_EMPTY_CELL_ERROR
+  bool empty = classification.label == NO_DIGIT_FOUND;
+  double emptyProbability = empty ? 1.0 - VOTING_EMPTY_CELL_ERROR : VOTING_EMPTY_CELL_ERROR;
+  _logLikelihoods[0] += std::log(emptyProbability);
+
+  for (size_t digit = 1; digit <= NUM_DIGITS; ++digit)
+  {
+    double probability = empty ? VOTING_EMPTY_CELL_ERROR / NUM_DIGITS
+                               : (1.0 - VOTING_EMPTY_CELL_ERROR) * classification.scores[digit - 1];
+    _logLikelihoods[digit] += std::log(std::max(probability, VOTING_MIN_PROBABILITY));
+  }
+
+  _best = 0;
+  _second = 1;
+  for (size_t i = 1; i <= NUM_DIGITS; ++i)
+  {
+    if (_logLikelihoods[i] > _logLikelihoods[_best])
+    {
+      _second = _best;
+      _best = i;
+    }
+    else if (_logLikelihoods[i] > _logLikelihoods[_second] || _second == _best)
+    {
+      _second = i;
+    }
+  }
+
+  if (_repeats >= NUM_FRAMES_FIXED && digit() == _label)
+    return true;
+
+  return _evidenceFrames >= VOTING_MIN_FRAMES
+      && _logLikelihoods[_best] - _logLikelihoods[_second] >= VOTING_LOG_LIKELIHOOD_RATIO;
+}
+
+uchar LikelihoodDigitVoter::digit() const
+{
+  return _best == 0 ? NO_DIGIT_FOUND : static_cast<uchar>(_best);
+}
+
+float LikelihoodDigitVoter::confidence() const
+{
+  // posterior of the best class under a uniform prior
+  double sum = 0.0;
+  for (size_t i = 0; i <= NUM_DIGITS; ++i)
+    sum += std::exp(_logLikelihoods[i] - _logLikelihoods[_best]);
+
+  return static_cast<float>(1.0 / sum);
+}
@@ -0,0 +1,219 @@
+#include "../../include/pipeline/stagedpipeline.hpp"
+
+#include "../../include/settings.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+StagedPipeline::StagedPipeline(SudokuPipeline& pipeline, FrameSource& frameSource) :
+  _pipeline(pipeline),
+  _frameSource(frameSource),
+  _lossless(! frameSource.isLive()),
+  _running(false),
+  _captureDone(true),
+  _detectDone(true),
+  _recognizeDone(true),
+  _renderDone(true),
+  _capturedFrames(0),
+  _renderedFrames(0),
+  _droppedFrames(0),
+  _lastLatencyMs(0.0),
+  _latencySumMs(0.0),
+  _maxLatencyMs(0.0)
+{
+}
+
+StagedPipeline::~StagedPipeline()
+{
+  stop();
+  wait();
+}
+
+void StagedPipeline::start(const FrameCallback& callback)
+{
+  wait();
+
+  _callback = callback;
+  _running = true;
+  _captureDone = false;
+  _detectDone = false;
+  _recognizeDone = false;
+  _renderDone = false;
+
+  _renderThread = std::thread(&StagedPipeline::render, this);
+  _recognizeThread = std::thread(&StagedPipeline::recognize, this);
+  _detectThread = std::thread(&StagedPipeline::detect, this);
+  _captureThread = std::thread(&StagedPipeline::capture, this);
+}
+
+void StagedPipeline::stop()
+{
+  _running = false;
+
+  _captured.wake();
+  _detected.wake();
+  _recognized.wake();
+}
+
+void StagedPipeline::wait()
+{
+  if (_captureThread.joinable())
+    _captureThread.join();
+  if (_detectThread.joinable())
+    _detectThread.join();
+  if (_recognizeThread.joinable())
+    _recognizeThread.join();
+  if (_renderThread.joinable())
+    _renderThread.join();
+}
+
+bool StagedPipeline::isRunning() const
+{
+  return ! _renderDone;
+}
+
+size_t StagedPipeline::capturedFrames() const
+{
+  return _capturedFrames;
+}
+
+size_t StagedPipeline::renderedFrames() const
+{
+  return _renderedFrames;
+}
+
+size_t StagedPipeline::droppedFrames() const
+{
+  return _droppedFrames + _frameSource.droppedFrames();
+}
+
+double StagedPipeline::lastLatencyMs() const
+{
+  std::lock_guard<std::mutex> lock(_latencyMutex);
+  return _lastLatencyMs;
+}
+
+double StagedPipeline::meanLatencyMs() const
+{
+  std::lock_guard<std::mutex> lock(_latencyMutex);
+  return _renderedFrames > 0 ? _latencySumMs / _renderedFrames : 0.0;
+}
+
+double StagedPipeline::maxLatencyMs() const
+{
+  std::lock_guard<std::mutex> lock(_latencyMutex);
+  return _maxLatencyMs;
+}
+
+void StagedPipeline::publish(LatestSlot<PipelineFrame>& slot, std::unique_ptr<PipelineFrame> frame)
+{
+  // without a live source every frame counts, so wait until the next stage took the last one
+  if (_lossless)
+    slot.waitUntil([&]() { return slot.empty() || ! _running; });
+
+  // only this stage publishes, so nothing can arrive between taking and publishing
+  std::unique_ptr<PipelineFrame> dropped = slot.take();
+  if (dropped)
+  {
+    // the events of the dropped frame must still reach the next stages
+    frame->result.mergeDropped(dropped->result);
+    ++_droppedFrames;
+  }
+
+  slot.publish(std::move(frame));
+}
+
+std::unique_ptr<PipelineFrame> StagedPipeline::take(LatestSlot<PipelineFrame>& slot, const std::atomic<bool>& upstreamDone)
+{
+  while (_running)
+  {
+    std::unique_ptr<PipelineFrame> frame = slot.take();
+    if (frame)
+      return frame;
+
+    // the upstream stage may have published its last frame right before finishing
+    if (upstreamDone)
+      return slot.take();
+
+    slot.waitUntil([&]() { return ! slot.empty() || upstreamDone || ! _running; });
+  }
+
+  return std::unique_ptr<PipelineFrame>();
+}
+
+void StagedPipeline::capture()
+{
+  size_t sequence = 0;
+
+  while (_running)
+  {
+    std::unique_ptr<PipelineFrame> frame(new PipelineFrame());
+    if (! _frameSource.readTimestamped(frame->frame, frame->captureTicks))
+      break;
+
+    frame->sequence = sequence++;
+    ++_capturedFrames;
+
+    publish(_captured, std::move(frame));
+
+    // a live source delivers at its own rate
+    if (! _frameSource.isLive() && _frameSource.getPacing() == FrameSource::PACING_REALTIME)
+      std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_DELAY_MS));
+  }
+
+  _captureDone = true;
+  _captured.wake();
+}
+
+void StagedPipeline::detect()
+{
+  std::unique_ptr<PipelineFrame> frame;
+  while ((frame = take(_captured, _captureDone)))
+  {
+    _pipeline.detect(*frame);
+    // the detection stage reuses its buffers for the next frame
+    frame->finder->detach();
+
+    publish(_detected, std::move(frame));
+  }
+
+  _detectDone = true;
+  _detected.wake();
+}
+
+void StagedPipeline::recognize()
+{
+  std::unique_ptr<PipelineFrame> frame;
+  while ((frame = take(_detected, _detectDone)))
+  {
+    _pipeline.recognize(*frame);
+
+    publish(_recognized, std::move(frame));
+  }
+
+  _recognizeDone = true;
+  _recognized.wake();
+}
+
+void StagedPipeline::render()
+{
+  std::unique_ptr<PipelineFrame> frame;
+  while ((frame = take(_recognized, _recognizeDone)))
+  {
+    _pipeline.render(*frame);
+
+    if (_callback)
+      _callback(*frame);
+
+    double latencyMs = frame->ageMs();
+    {
+      std::lock_guard<std::mutex> lock(_latencyMutex);
+      _lastLatencyMs = latencyMs;
+      _latencySumMs += latencyMs;
+      _maxLatencyMs = std::max(_maxLatencyMs, latencyMs);
+      ++_renderedFrames;
+    }
+  }
+
+  _renderDone = true;
+}
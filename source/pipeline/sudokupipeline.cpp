@@ -0,0 +1,518 @@
+#include "../../include/pipeline/sudokupipeline.hpp"
+
+#include "../../include/utils/drawutils.hpp"
+#include "../../include/classification/cascadedigitclassifier.hpp"
+#include "../../include/solver/sudoku.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void PipelineResult::mergeDropped(const PipelineResult& older)
+{
+  // a disappearance followed by a new appearance is reported in that order
+  if (! disappeared)
+  {
+    disappeared = older.disappeared;
+    appeared = appeared || older.appeared;
+  }
+
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      updated[row][col] = updated[row][col] || older.updated[row][col];
+      newlyFixed[row][col] = newlyFixed[row][col] || older.newlyFixed[row][col];
+    }
+  }
+
+  allDigitsFixed = allDigitsFixed || older.allDigitsFixed;
+}
+
+double PipelineFrame::ageMs() const
+{
+  return (cv::getTickCount() - captureTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+SudokuPipeline::SudokuPipeline() :
+  _sudokuFinder(SUDOKU_CELL_WORKING_SIZE, DIRECT_CELL_SAMPLE_SIZE),
+  _found(false),
+  _lostCount(0),
+  _cellFinder(_sudokuFinder),
+  _digitExtractor(_cellFinder),
+  _classifierBackend(static_cast<ClassifierBackend::Type>(CLASSIFIER_BACKEND)),
+  _digitClassifier(ClassifierBackend::create(_classifierBackend, _digitExtractor)),
+  _autoSolve(false),
+  _solved(false),
+  _solutionPending(false)
+{
+  for (size_t i = 0; i < 3; ++i)
+    _sceneChangeCounts[i] = 0;
+
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      _digitVoters[row][col].reset(DigitVoter::create());
+
+  _lockedCells = 0;
+  _framesToLockSum = 0;
+  _lastGridFramesToLock = 0;
+
+  reset();
+}
+
+SudokuPipeline::~SudokuPipeline()
+{
+}
+
+const cv::Mat& SudokuPipeline::getFrame() const
+{
+  return _outputFrame;
+}
+
+size_t SudokuPipeline::getCellSize() const
+{
+  return _cellFinder.getCellSize();
+}
+
+void SudokuPipeline::setCellSampleSize(size_t cellSampleSize)
+{
+  _sudokuFinder.setCellSampleSize(cellSampleSize);
+}
+
+size_t SudokuPipeline::sceneChangeCount(SudokuFinder::SceneChange sceneChange) const
+{
+  return _sceneChangeCounts[sceneChange];
+}
+
+double SudokuPipeline::skipRatio() const
+{
+  size_t changed = _sceneChangeCounts[SudokuFinder::SCENE_CHANGED];
+  size_t skipped = _sceneChangeCounts[SudokuFinder::SCENE_MOVED] + _sceneChangeCounts[SudokuFinder::SCENE_STATIC];
+
+  return changed + skipped > 0 ? static_cast<double>(skipped) / (changed + skipped) : 0.0;
+}
+
+double SudokuPipeline::meanFramesToLock() const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _lockedCells > 0 ? static_cast<double>(_framesToLockSum) / _lockedCells : 0.0;
+}
+
+size_t SudokuPipeline::lastGridFramesToLock() const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _lastGridFramesToLock;
+}
+
+double SudokuPipeline::cacheHitRate() const
+{
+  return _classificationCache.hitRate();
+}
+
+double SudokuPipeline::escalationRate() const
+{
+  std::shared_ptr<DigitClassifier> digitClassifier = classifier();
+  const CascadeDigitClassifier *cascade = dynamic_cast<const CascadeDigitClassifier*>(digitClassifier.get());
+  return cascade ? cascade->escalationRate() : 0.0;
+}
+
+void SudokuPipeline::setAutoSolve(bool autoSolve)
+{
+  _autoSolve = autoSolve;
+}
+
+void SudokuPipeline::reset()
+{
+  {
+    std::lock_guard<std::mutex> lock(_recognitionMutex);
+    resetResponses();
+  }
+
+  unshowSolution();
+}
+
+void SudokuPipeline::resetResponses()
+{
+  _responseCount = 0;
+  _allFixed = false;
+  _fixedSent = false;
+  _lastDigitsValid = false;
+  // a grid that shows up again starts over with fresh classifications
+  _classificationCache.clear();
+  _digitExtractor.reset();
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      _digitFixed[row][col] = false;
+      _fixedDigits[row][col] = NO_DIGIT_FOUND;
+      _digitVoters[row][col]->reset();
+    }
+  }
+}
+
+bool SudokuPipeline::process(const cv::Mat& frame, PipelineResult& result)
+{
+  PipelineFrame pipelineFrame;
+  pipelineFrame.frame = frame;
+  pipelineFrame.captureTicks = cv::getTickCount();
+
+  detect(pipelineFrame);
+  recognize(pipelineFrame);
+  render(pipelineFrame);
+
+  _outputFrame = pipelineFrame.frame;
+  result = pipelineFrame.result;
+
+  return result.found;
+}
+
+void SudokuPipeline::detect(PipelineFrame& frame)
+{
+  PipelineResult& result = frame.result;
+  result = PipelineResult();
+
+  applySolution();
+
+  bool found = _sudokuFinder.updateFrame(frame.frame);
+  ++_sceneChangeCounts[_sudokuFinder.getSceneChange()];
+
+  if (found)
+  {
+    _lostCount = 0;
+    if (! _found)
+    {
+      _found = true;
+      result.appeared = true;
+    }
+    result.found = true;
+  }
+  else if (++_lostCount == NUM_FRAMES_LOST)
+  {
+    _found = false;
+    _lostCount = 0;
+    _sudokuFinder.unshowSolution();
+    result.disappeared = true;
+  }
+
+  // only the results travel with the frame, not the search and tracking state
+  frame.finder = std::make_shared<SudokuFinder>(SUDOKU_CELL_WORKING_SIZE);
+  frame.finder->copyResults(_sudokuFinder);
+}
+
+void SudokuPipeline::recognize(PipelineFrame& frame)
+{
+  PipelineResult& result = frame.result;
+
+  {
+    std::lock_guard<std::mutex> lock(_recognitionMutex);
+
+    if (result.disappeared)
+      resetResponses();
+    // the hysteresis of the empty cell check must not carry over to another grid
+    if (result.appeared)
+      _digitExtractor.reset();
+
+    if (result.found)
+    {
+      _cellFinder.copyResults(*frame.finder);
+      _digitExtractor.updateCells();
+
+      if (classifier()->hasModel())
+        classifyDigits(result);
+    }
+  }
+
+  if (result.disappeared)
+    unshowSolution();
+  else if (result.allDigitsFixed && _autoSolve)
+    solve();
+
+  fillResult(result);
+}
+
+void SudokuPipeline::render(PipelineFrame& frame) const
+{
+  frame.frame = frame.finder->getFrame();
+
+  if (frame.result.found)
+  {
+    const Color &frameColor = frame.result.allFixed ? DrawUtils::COLOR_GREEN : DrawUtils::COLOR_RED;
+    DrawUtils::drawContour(frame.frame, frame.finder->getFoundSudokuContour(), frameColor, 3);
+  }
+}
+
+void SudokuPipeline::classifyDigits(PipelineResult& result)
+{
+  // the same rectification and model yield the same responses as the last frame
+  std::shared_ptr<DigitClassifier> digitClassifier = classifier();
+  size_t modelGeneration = digitClassifier->modelGeneration();
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    std::fill(_freshClassifications[row], _freshClassifications[row] + NUM_ROWS_CELLS, false);
+
+  if (! _lastDigitsValid || _cellFinder.getRectificationId() != _lastRectificationId
+      || modelGeneration != _lastModelGeneration)
+  {
+    // cells that look like before reuse their classification, the others
+    // go through the classifier in one batch, the buffers are kept between frames
+    static thread_local std::vector<cv::Point> cells;
+    static thread_local std::vector<uint64> signatures;
+    static thread_local std::vector<Classification> classifications;
+    cells.clear();
+    signatures.clear();
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    {
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      {
+        _lastClassifications[row][col] = Classification();
+
+        // the empty cell check ran on the new rectification
+        cv::Mat digit;
+        _freshClassifications[row][col] = true;
+        if (_digitFixed[row][col] || ! _digitExtractor.containsDigit(row, col)
+            || ! _digitExtractor.digit(row, col, digit))
+          continue;
+
+        _freshClassifications[row][col] = false;
+
+        uint64 signature = ClassificationCache::signature(digit);
+        if (! _classificationCache.lookup(row, col, signature, modelGeneration, _lastClassifications[row][col]))
+        {
+          cells.push_back(cv::Point(col, row));
+          signatures.push_back(signature);
+        }
+      }
+    }
+
+    digitClassifier->classifyCells(cells, classifications);
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+      _lastClassifications[cells[i].y][cells[i].x] = classifications[i];
+      _freshClassifications[cells[i].y][cells[i].x] = true;
+      _classificationCache.store(cells[i].y, cells[i].x, signatures[i], modelGeneration, classifications[i]);
+    }
+  }
+
+  _allFixed = true;
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      if (_digitFixed[row][col])
+        continue;
+
+      DigitVoter& voter = *_digitVoters[row][col];
+      bool fixed = voter.add(_lastClassifications[row][col], _freshClassifications[row][col]);
+
+      result.updated[row][col] = true;
+      result.digits[row][col] = voter.digit();
+      result.confidences[row][col] = voter.confidence();
+
+      if (fixed)
+      {
+        _digitFixed[row][col] = true;
+        _fixedDigits[row][col] = voter.digit();
+        result.newlyFixed[row][col] = true;
+
+        ++_lockedCells;
+        _framesToLockSum += voter.frames();
+      }
+      else
+      {
+        _allFixed = false;
+        _fixedSent = false;
+      }
+    }
+  }
+
+  _lastDigitsValid = true;
+  _lastRectificationId = _cellFinder.getRectificationId();
+  _lastModelGeneration = modelGeneration;
+
+  ++_responseCount;
+
+  if (_allFixed && ! _fixedSent)
+  {
+    _fixedSent = true;
+    _lastGridFramesToLock = _responseCount;
+    result.allDigitsFixed = true;
+  }
+}
+
+void SudokuPipeline::fillResult(PipelineResult& result) const
+{
+  {
+    std::lock_guard<std::mutex> lock(_recognitionMutex);
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    {
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      {
+        result.fixed[row][col] = _digitFixed[row][col];
+        if (_digitFixed[row][col])
+        {
+          result.digits[row][col] = _fixedDigits[row][col];
+          result.confidences[row][col] = 1.f;
+        }
+      }
+    }
+    result.allFixed = _allFixed;
+  }
+
+  std::lock_guard<std::mutex> lock(_solutionMutex);
+  result.solved = _solved;
+  memcpy(result.solution, _solution, NUM_ROWS_CELLS*NUM_ROWS_CELLS);
+}
+
+bool SudokuPipeline::solve()
+{
+  std::vector<std::vector<int>> fields;
+  {
+    std::lock_guard<std::mutex> lock(_recognitionMutex);
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    {
+      std::vector<int> tmp;
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+        tmp.push_back(_fixedDigits[row][col]);
+      fields.push_back(tmp);
+    }
+  }
+
+  try
+  {
+    Sudoku s(fields);
+    if (! s.solveSudoku())
+      return false;
+
+    const std::vector<std::vector<int>> solved = s.getSolution();
+    uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS];
+    for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+    {
+      for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+      {
+        if (fields[row][col] == NO_DIGIT_FOUND)
+          solution[row][col] = static_cast<uchar>(solved[row][col]);
+        else
+          solution[row][col] = NO_DIGIT_FOUND;
+      }
+    }
+
+    showSolution(solution);
+    return true;
+  }
+  catch (const int)
+  {
+    return false;
+  }
+}
+
+void SudokuPipeline::showSolution(const uchar solution[NUM_ROWS_CELLS][NUM_ROWS_CELLS])
+{
+  std::lock_guard<std::mutex> lock(_solutionMutex);
+  memcpy(_solution, solution, NUM_ROWS_CELLS*NUM_ROWS_CELLS);
+  _solved = true;
+  _solutionPending = true;
+}
+
+void SudokuPipeline::unshowSolution()
+{
+  std::lock_guard<std::mutex> lock(_solutionMutex);
+  memset(_solution, NO_DIGIT_FOUND, NUM_ROWS_CELLS*NUM_ROWS_CELLS);
+  _solved = false;
+  _solutionPending = true;
+}
+
+void SudokuPipeline::applySolution()
+{
+  // the overlay belongs to the detection stage, so it picks up changes from other threads here
+  std::lock_guard<std::mutex> lock(_solutionMutex);
+  if (! _solutionPending)
+    return;
+
+  _solutionPending = false;
+  if (_solved)
+    _sudokuFinder.showSolution(_solution);
+  else
+    _sudokuFinder.unshowSolution();
+}
+
+std::shared_ptr<DigitClassifier> SudokuPipeline::classifier() const
+{
+  return std::atomic_load(&_digitClassifier);
+}
+
+void SudokuPipeline::setClassifierBackend(ClassifierBackend::Type backend)
+{
+  std::shared_ptr<DigitClassifier> digitClassifier(ClassifierBackend::create(backend, _digitExtractor));
+
+  // the generations of the new classifier's models start over, so nothing cached may be reused
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  _classifierBackend = backend;
+  _lastDigitsValid = false;
+  _classificationCache.clear();
+  std::atomic_store(&_digitClassifier, digitClassifier);
+}
+
+ClassifierBackend::Type SudokuPipeline::classifierBackend() const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _classifierBackend;
+}
+
+void SudokuPipeline::train(const std::vector<cv::Mat> *trainingImages)
+{
+  classifier()->train(trainingImages);
+}
+
+bool SudokuPipeline::loadClassifier(const std::string& filename)
+{
+  return classifier()->load(filename);
+}
+
+bool SudokuPipeline::saveClassifier(const std::string& filename) const
+{
+  return classifier()->save(filename);
+}
+
+void SudokuPipeline::setClassifierFeatures(DigitFeatures::Type features)
+{
+  classifier()->setFeatures(features);
+}
+
+bool SudokuPipeline::hasClassifier() const
+{
+  return classifier()->hasModel();
+}
+
+bool SudokuPipeline::containsDigit(size_t row, size_t col) const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _digitExtractor.containsDigit(row, col);
+}
+
+bool SudokuPipeline::cell(size_t row, size_t col, cv::Mat& cell) const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _cellFinder.cell(row, col, cell);
+}
+
+bool SudokuPipeline::preparedCell(size_t row, size_t col, cv::Mat& cell) const
+{
+  std::lock_guard<std::mutex> lock(_recognitionMutex);
+  return _digitExtractor.cell(row, col, cell);
+}
+
+uchar SudokuPipeline::getDigit(size_t row, size_t col)
+{
+  std::vector<cv::Point> cells(1, cv::Point(col, row));
+  std::vector<Classification> classifications;
+  {
+    // like the recognition, the classifier samples the digit at the size of its model,
+    // normalized and scaled in one resampling, so the extractor must not change meanwhile
+    std::lock_guard<std::mutex> lock(_recognitionMutex);
+    if (! _digitExtractor.containsDigit(row, col))
+      return NO_DIGIT_FOUND;
+
+    classifier()->classifyCells(cells, classifications);
+  }
+
+  return classifications[0].label;
+}
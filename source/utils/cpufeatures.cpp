@@ -0,0 +1,11 @@
+#include "../../include/utils/cpufeatures.hpp"
+
+bool CPUFeatures::hasAVX2()
+{
+#ifdef CPU_AVX2_KERNELS
+  static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+  return supported;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,101 @@
+#include "../../include/utils/mappedfile.hpp"
+
+#include <cstdint>
+#include <fstream>
+
+#define MAPPED_FILE_ALIGNMENT 64
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#endif
+
+MappedFile::MappedFile()
+  : _data(nullptr),
+    _size(0),
+    _mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+  close();
+
+#ifdef HAVE_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  _data = static_cast<const char*>(data);
+  _size = status.st_size;
+  _mapped = true;
+#else
+  std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (! file)
+    return false;
+
+  // aligned like a mapping, so the data can be read with aligned loads
+  size_t size = static_cast<size_t>(file.tellg());
+  _buffer.resize(size + MAPPED_FILE_ALIGNMENT);
+  size_t offset = (MAPPED_FILE_ALIGNMENT - reinterpret_cast<uintptr_t>(&_buffer[0]) % MAPPED_FILE_ALIGNMENT) % MAPPED_FILE_ALIGNMENT;
+  file.seekg(0);
+  if (size == 0 || ! file.read(&_buffer[offset], size))
+  {
+    _buffer.clear();
+    return false;
+  }
+
+  _data = &_buffer[offset];
+  _size = size;
+#endif
+
+  return true;
+}
+
+void MappedFile::close()
+{
+#ifdef HAVE_MMAP
+  if (_mapped)
+    munmap(const_cast<char*>(_data), _size);
+#endif
+
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+  _buffer.clear();
+}
+
+bool MappedFile::isOpen() const
+{
+  return _data != nullptr;
+}
+
+const char* MappedFile::data() const
+{
+  return _data;
+}
+
+size_t MappedFile::size() const
+{
+  return _size;
+}
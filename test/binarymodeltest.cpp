@@ -0,0 +1,173 @@
+#include "../include/classification/binarymodel.hpp"
+#include "testutils.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// the headers of the older versions, as they were written
+struct HeaderV1
+{
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  uint32_t type;
+  uint32_t sampleWidth;
+  uint32_t pcaComponents;
+  uint32_t varCount;
+  uint32_t stride;
+  uint32_t svCount;
+  uint32_t classCount;
+  uint32_t coefficientCount;
+  float gamma;
+  uint64_t offsets[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+  uint64_t sizes[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+};
+
+struct HeaderV2
+{
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  uint32_t type;
+  uint32_t sampleWidth;
+  uint32_t features;
+  uint32_t pcaComponents;
+  uint32_t varCount;
+  uint32_t stride;
+  uint32_t svCount;
+  uint32_t classCount;
+  uint32_t coefficientCount;
+  float gamma;
+  uint64_t offsets[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+  uint64_t sizes[BinaryModelHeader::SECTION_SUPPORT_VECTORS + 1];
+};
+
+static std::vector<char> readFile(const std::string& filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& filename, const std::vector<char>& bytes)
+{
+  std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+  file.write(&bytes[0], bytes.size());
+}
+
+// the sections stay where they are, only the header in front is replaced
+template<typename Header>
+static void downgrade(const BinaryModelHeader& current, Header& old, uint32_t version)
+{
+  memcpy(old.magic, current.magic, sizeof(old.magic));
+  old.byteOrder = current.byteOrder;
+  old.version = version;
+  old.type = current.type;
+  old.sampleWidth = current.sampleWidth;
+  old.pcaComponents = current.pcaComponents;
+  old.varCount = current.varCount;
+  old.stride = current.stride;
+  old.svCount = current.svCount;
+  old.classCount = current.classCount;
+  old.coefficientCount = current.coefficientCount;
+  old.gamma = current.gamma;
+  for (size_t i = 0; i <= BinaryModelHeader::SECTION_SUPPORT_VECTORS; ++i)
+  {
+    old.offsets[i] = current.offsets[i];
+    old.sizes[i] = current.sizes[i];
+  }
+}
+
+static void checkSections(const BinaryModelReader& reader, const std::vector<float>& norms, bool sigmoids)
+{
+  const float *readNorms = reader.section<float>(BinaryModelHeader::SECTION_SQUARED_NORMS, norms.size());
+  TEST_CHECK(readNorms != nullptr);
+  if (readNorms)
+    TEST_CHECK(std::equal(norms.begin(), norms.end(), readNorms));
+
+  TEST_CHECK((reader.section<double>(BinaryModelHeader::SECTION_SIGMOIDS, 4) != nullptr) == sigmoids);
+  // a section is only handed out with its exact size
+  TEST_CHECK(reader.section<float>(BinaryModelHeader::SECTION_SQUARED_NORMS, norms.size() + 1) == nullptr);
+}
+
+int main()
+{
+  std::string filename = temporaryFilename("model.bin");
+
+  std::vector<float> norms = {1.f, 2.5f, -3.f, 4.f, 0.125f};
+  std::vector<double> sigmoids = {-4.5, 0.1, -5.2, -0.3};
+
+  BinaryModelWriter writer;
+  writer.header().type = BinaryModelHeader::TYPE_RBF_SVM;
+  writer.header().sampleWidth = 16;
+  writer.header().features = 1;
+  writer.header().svCount = norms.size();
+  writer.header().gamma = 0.03f;
+  writer.setSection(BinaryModelHeader::SECTION_SQUARED_NORMS, &norms[0], norms.size() * sizeof(float));
+  writer.setSection(BinaryModelHeader::SECTION_SIGMOIDS, &sigmoids[0], sigmoids.size() * sizeof(double));
+  TEST_CHECK(writer.write(filename));
+  TEST_CHECK(BinaryModelWriter::isBinaryFilename(filename));
+
+  BinaryModelReader reader;
+  TEST_CHECK(reader.open(filename));
+  TEST_CHECK(reader.header().version == BINARY_MODEL_VERSION);
+  TEST_CHECK(reader.header().sampleWidth == 16);
+  TEST_CHECK(reader.header().features == 1);
+  TEST_CHECK(reader.header().svCount == norms.size());
+  TEST_CHECK(reader.header().gamma == 0.03f);
+  checkSections(reader, norms, true);
+
+  std::vector<char> bytes = readFile(filename);
+  BinaryModelHeader current = reader.header();
+
+  // version 1 files have no features and are pixel models
+  HeaderV1 v1;
+  downgrade(current, v1, 1);
+  std::vector<char> v1Bytes(bytes);
+  memcpy(&v1Bytes[0], &v1, sizeof(v1));
+  writeFile(filename, v1Bytes);
+
+  BinaryModelReader v1Reader;
+  TEST_CHECK(v1Reader.open(filename));
+  TEST_CHECK(v1Reader.header().version == 1);
+  TEST_CHECK(v1Reader.header().sampleWidth == 16);
+  TEST_CHECK(v1Reader.header().features == 0);
+  TEST_CHECK(v1Reader.header().svCount == norms.size());
+  checkSections(v1Reader, norms, false);
+
+  // version 2 files keep their features but have no sigmoids
+  HeaderV2 v2;
+  downgrade(current, v2, 2);
+  v2.features = current.features;
+  std::vector<char> v2Bytes(bytes);
+  memcpy(&v2Bytes[0], &v2, sizeof(v2));
+  writeFile(filename, v2Bytes);
+
+  BinaryModelReader v2Reader;
+  TEST_CHECK(v2Reader.open(filename));
+  TEST_CHECK(v2Reader.header().version == 2);
+  TEST_CHECK(v2Reader.header().features == 1);
+  checkSections(v2Reader, norms, false);
+
+  // unknown versions, foreign byte orders and truncated files are refused
+  std::vector<char> broken(bytes);
+  uint32_t version = BINARY_MODEL_VERSION + 1;
+  memcpy(&broken[offsetof(BinaryModelHeader, version)], &version, sizeof(version));
+  writeFile(filename, broken);
+  TEST_CHECK(! BinaryModelReader().open(filename));
+
+  broken = bytes;
+  std::swap(broken[offsetof(BinaryModelHeader, byteOrder)], broken[offsetof(BinaryModelHeader, byteOrder) + 3]);
+  writeFile(filename, broken);
+  TEST_CHECK(! BinaryModelReader().open(filename));
+
+  broken.assign(bytes.begin(), bytes.end() - 64);
+  writeFile(filename, broken);
+  TEST_CHECK(! BinaryModelReader().open(filename));
+
+  std::remove(filename.c_str());
+  return testFailures;
+}
@@ -0,0 +1,63 @@
+#include "../include/classification/trainingset.hpp"
+#include "../include/imgproc/digitextractor.hpp"
+#include "../include/imgproc/sudokufinder.hpp"
+#include "../include/settings.hpp"
+#include "testutils.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// mean absolute difference per pixel between resampling once and resampling twice,
+// over the whole training set and for a single image
+#define EXTRACTOR_TEST_MAX_MEAN_DIFFERENCE 14.0
+#define EXTRACTOR_TEST_MAX_IMAGE_DIFFERENCE 28.0
+
+// the fused normalization maps every sample pixel through the normalization into
+// the mask; warping the mask at cell size with the same map, cropping the box and
+// scaling it down has to give the same sample up to the second interpolation
+int main()
+{
+  std::vector<cv::Mat> images[9];
+  TEST_CHECK(TrainingSet::load(TRAINING_DATA_DIR, images));
+
+  SudokuFinder sudokuFinder(SUDOKU_CELL_WORKING_SIZE, DIRECT_CELL_SAMPLE_SIZE);
+  DigitExtractor extractor(sudokuFinder);
+  extractor.setFusedNormalization(true);
+  cv::Size size(DIGIT_SAMPLE_WIDTH, DIGIT_SAMPLE_WIDTH);
+
+  size_t samples = 0, emptyMismatches = 0;
+  double difference = 0.0, maxDifference = 0.0;
+  for (int digit = 0; digit < 9; ++digit)
+  {
+    for (const cv::Mat& image : images[digit])
+    {
+      cv::Mat fused, normalized, twoStep;
+      cv::Rect boundingBox;
+      extractor.extractDigit(image, size, fused);
+      extractor.extractDigit(image, normalized, boundingBox);
+      cv::resize(normalized(boundingBox), twoStep, size);
+
+      TEST_CHECK(fused.size() == size && fused.type() == twoStep.type());
+      if (fused.size() != size || fused.type() != twoStep.type())
+        continue;
+
+      if ((cv::countNonZero(fused) == 0) != (cv::countNonZero(twoStep) == 0))
+        ++emptyMismatches;
+      double imageDifference = cv::norm(fused, twoStep, cv::NORM_L1) / size.area();
+      maxDifference = std::max(maxDifference, imageDifference);
+      difference += imageDifference;
+      ++samples;
+    }
+  }
+
+  TEST_CHECK(samples > 0);
+  TEST_CHECK(emptyMismatches == 0);
+  TEST_CHECK(maxDifference < EXTRACTOR_TEST_MAX_IMAGE_DIFFERENCE);
+  if (samples > 0)
+    TEST_CHECK(difference / samples < EXTRACTOR_TEST_MAX_MEAN_DIFFERENCE);
+
+  return testFailures;
+}
@@ -0,0 +1,107 @@
+#include "../include/utils/latestslot.hpp"
+#include "testutils.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#define LATEST_SLOT_TEST_ITEMS 100000
+
+// counts its live instances, so leaks and double deletes show up
+struct Item
+{
+  static std::atomic<int> instances;
+
+  explicit Item(size_t value) : value(value)
+  {
+    ++instances;
+  }
+
+  ~Item()
+  {
+    --instances;
+  }
+
+  size_t value;
+};
+
+std::atomic<int> Item::instances(0);
+
+static void testSingleThread()
+{
+  LatestSlot<Item> slot;
+  TEST_CHECK(slot.empty());
+  TEST_CHECK(! slot.take());
+
+  slot.publish(std::unique_ptr<Item>(new Item(1)));
+  TEST_CHECK(! slot.empty());
+
+  // a newer item replaces the one not taken yet
+  slot.publish(std::unique_ptr<Item>(new Item(2)));
+  TEST_CHECK(slot.dropped() == 1);
+  TEST_CHECK(Item::instances == 1);
+
+  std::unique_ptr<Item> item = slot.take();
+  TEST_CHECK(item && item->value == 2);
+  TEST_CHECK(slot.empty());
+  TEST_CHECK(! slot.take());
+
+  // the slot deletes what nobody took
+  {
+    LatestSlot<Item> abandoned;
+    abandoned.publish(std::unique_ptr<Item>(new Item(3)));
+  }
+  TEST_CHECK(Item::instances == 1);
+}
+
+// the consumer blocks until something arrives, sees increasing values ending
+// with the last one, and every item is either taken or counted as dropped
+static void testHandoff()
+{
+  LatestSlot<Item> slot;
+  std::atomic<bool> done(false);
+  size_t taken = 0, last = 0;
+  bool increasing = true;
+
+  std::thread consumer([&]()
+  {
+    for (;;)
+    {
+      bool finished = done;
+      std::unique_ptr<Item> item = slot.take();
+      if (item)
+      {
+        increasing = increasing && item->value > last;
+        last = item->value;
+        ++taken;
+      }
+      else if (finished)
+      {
+        break;
+      }
+      else
+      {
+        slot.waitUntil([&]() { return ! slot.empty() || done; });
+      }
+    }
+  });
+
+  for (size_t i = 1; i <= LATEST_SLOT_TEST_ITEMS; ++i)
+    slot.publish(std::unique_ptr<Item>(new Item(i)));
+  done = true;
+  slot.wake();
+  consumer.join();
+
+  TEST_CHECK(increasing);
+  TEST_CHECK(last == LATEST_SLOT_TEST_ITEMS);
+  TEST_CHECK(taken + slot.dropped() == LATEST_SLOT_TEST_ITEMS);
+  TEST_CHECK(Item::instances == 0);
+}
+
+int main()
+{
+  testSingleThread();
+  testHandoff();
+
+  return testFailures;
+}
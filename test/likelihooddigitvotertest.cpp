@@ -0,0 +1,64 @@
+#include "../include/classification/digitclassifier.hpp"
+#include "../include/pipeline/likelihooddigitvoter.hpp"
+#include "../include/settings.hpp"
+#include "testutils.hpp"
+
+#define VOTER_TEST_DIGIT 7
+#define VOTER_TEST_FRAMES (2 * NUM_FRAMES_FIXED)
+
+// a classification of the digit with the given probability, the rest spread evenly
+static Classification classification(uchar digit, float probability)
+{
+  Classification classification;
+  for (size_t i = 0; i < NUM_DIGITS; ++i)
+    classification.scores[i] = (1.f - probability) / (NUM_DIGITS - 1);
+  classification.scores[digit - 1] = probability;
+  classification.finish(digit);
+  return classification;
+}
+
+// feeds the same classification until the voter fixes the digit, returns the frames it took
+static size_t framesToFix(LikelihoodDigitVoter& voter, const Classification& classification,
+                          bool firstFresh, bool fresh)
+{
+  for (size_t frame = 1; frame <= VOTER_TEST_FRAMES; ++frame)
+  {
+    if (voter.add(classification, frame == 1 ? firstFresh : fresh))
+      return frame;
+  }
+
+  return 0;
+}
+
+int main()
+{
+  Classification seven = classification(VOTER_TEST_DIGIT, 0.9f);
+
+  // fresh classifications fix the digit after the minimum number of frames
+  LikelihoodDigitVoter voter;
+  size_t frames = framesToFix(voter, seven, true, true);
+  TEST_CHECK(frames == VOTING_MIN_FRAMES);
+  TEST_CHECK(voter.digit() == VOTER_TEST_DIGIT);
+
+  // a classification reused from the last frame repeats until it is fixed as it stands
+  voter.reset();
+  frames = framesToFix(voter, seven, true, false);
+  TEST_CHECK(frames > 0 && frames <= NUM_FRAMES_FIXED);
+  TEST_CHECK(voter.digit() == VOTER_TEST_DIGIT);
+
+  // a grid shown again may only get cached classifications, the first one
+  // after the reset still counts, so the digit is fixed again
+  voter.reset();
+  TEST_CHECK(voter.digit() == NO_DIGIT_FOUND);
+  frames = framesToFix(voter, seven, false, false);
+  TEST_CHECK(frames > 0 && frames <= NUM_FRAMES_FIXED);
+  TEST_CHECK(voter.digit() == VOTER_TEST_DIGIT);
+
+  // an empty cell is fixed as empty
+  voter.reset();
+  frames = framesToFix(voter, Classification(), true, true);
+  TEST_CHECK(frames == VOTING_MIN_FRAMES);
+  TEST_CHECK(voter.digit() == NO_DIGIT_FOUND);
+
+  return testFailures;
+}
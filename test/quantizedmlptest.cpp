@@ -0,0 +1,119 @@
+#include "../include/classification/quantizedmlp.hpp"
+#include "testutils.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define MLP_TEST_SAMPLES 1000
+#define MLP_TEST_ALPHA (2.0 / 3.0)
+#define MLP_TEST_BETA 1.7159
+
+struct FloatLayer
+{
+  cv::Mat weights;
+  std::vector<float> bias;
+};
+
+static double activation(double x)
+{
+  double e = std::exp(-MLP_TEST_ALPHA * x);
+  return MLP_TEST_BETA * (1.0 - e) / (1.0 + e);
+}
+
+// the float network the int8 one approximates, scored like QuantizedMLP::predict
+static Classification classify(const std::vector<FloatLayer>& layers, const std::vector<float>& inputScale,
+                               const std::vector<float>& inputShift, const float* sample)
+{
+  std::vector<double> activations(sample, sample + inputScale.size());
+  for (size_t i = 0; i < activations.size(); ++i)
+    activations[i] = activations[i] * inputScale[i] + inputShift[i];
+
+  for (const FloatLayer& layer : layers)
+  {
+    std::vector<double> outputs(layer.weights.rows);
+    for (int o = 0; o < layer.weights.rows; ++o)
+    {
+      double x = layer.bias[o];
+      for (int i = 0; i < layer.weights.cols; ++i)
+        x += layer.weights.at<float>(o, i) * activations[i];
+      outputs[o] = activation(x);
+    }
+    activations.swap(outputs);
+  }
+
+  Classification classification;
+  size_t best = 0;
+  for (size_t digit = 0; digit < NUM_DIGITS; ++digit)
+  {
+    double output = activations[digit] * 0.5 + 0.5;
+    classification.scores[digit] = static_cast<float>(std::max(0.0, output));
+    if (activations[digit] > activations[best])
+      best = digit;
+  }
+  classification.finish(static_cast<uchar>(best + 1));
+  return classification;
+}
+
+int main()
+{
+  const int sizes[] = {256, 35, NUM_DIGITS};
+  cv::RNG rng(3);
+
+  // input factors as wide as CvANN_MLP's scaling of pixels, and neurons
+  // whose weights differ in magnitude by two orders
+  std::vector<float> inputScale(sizes[0]), inputShift(sizes[0]);
+  for (int i = 0; i < sizes[0]; ++i)
+  {
+    inputScale[i] = static_cast<float>(rng.uniform(2.0, 20.0));
+    inputShift[i] = -0.44f * inputScale[i];
+  }
+
+  QuantizedMLP mlp;
+  mlp.setActivation(MLP_TEST_ALPHA, MLP_TEST_BETA);
+  mlp.setInputScale(inputScale, inputShift);
+
+  std::vector<FloatLayer> layers(2);
+  for (size_t l = 0; l < layers.size(); ++l)
+  {
+    FloatLayer& layer = layers[l];
+    layer.weights.create(sizes[l + 1], sizes[l], CV_32FC1);
+    for (int o = 0; o < layer.weights.rows; ++o)
+    {
+      double magnitude = std::pow(10.0, rng.uniform(-1.0, 1.0));
+      for (int i = 0; i < layer.weights.cols; ++i)
+        layer.weights.at<float>(o, i) = static_cast<float>(rng.gaussian(0.1) * magnitude);
+      layer.bias.push_back(static_cast<float>(rng.gaussian(0.5)));
+    }
+    mlp.addLayer(layer.weights, layer.bias);
+  }
+  mlp.setOutputScale(std::vector<float>(NUM_DIGITS, 0.5f), std::vector<float>(NUM_DIGITS, 0.5f));
+  TEST_CHECK(mlp.inputs() == static_cast<size_t>(sizes[0]));
+
+  cv::Mat samples(MLP_TEST_SAMPLES, sizes[0], CV_32FC1);
+  for (int s = 0; s < samples.rows; ++s)
+    for (int i = 0; i < samples.cols; ++i)
+      samples.at<float>(s, i) = static_cast<float>(rng.uniform(0.0, 1.0));
+
+  std::vector<Classification> classifications(samples.rows);
+  mlp.predict(samples, classifications);
+
+  // random networks have close runner-ups, trained ones agree more often
+  size_t agreeing = 0;
+  double scoreError = 0.0;
+  for (int s = 0; s < samples.rows; ++s)
+  {
+    Classification expected = classify(layers, inputScale, inputShift, samples.ptr<float>(s));
+    if (classifications[s].label == expected.label)
+      ++agreeing;
+    for (size_t digit = 0; digit < NUM_DIGITS; ++digit)
+      scoreError += std::fabs(classifications[s].scores[digit] - expected.scores[digit]);
+  }
+
+  TEST_CHECK(agreeing >= 0.97 * samples.rows);
+  TEST_CHECK(scoreError / (samples.rows * NUM_DIGITS) < 0.005);
+
+  return testFailures;
+}
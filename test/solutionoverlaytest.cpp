@@ -0,0 +1,84 @@
+#include "../include/imgproc/sudokufinder.hpp"
+#include "../include/settings.hpp"
+#include "../include/typedefs.hpp"
+#include "testutils.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+#include <sstream>
+
+#define OVERLAY_TEST_FRAME_WIDTH 640
+#define OVERLAY_TEST_FRAME_HEIGHT 480
+
+// the solution digits in the rectified grid and the mask of their pixels
+static void renderSolution(cv::Mat& solution, cv::Mat& mask)
+{
+  size_t size = SUDOKU_CELL_WORKING_SIZE * NUM_ROWS_CELLS;
+  solution = cv::Mat::zeros(size, size, CV_8UC3);
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      std::stringstream ss;
+      ss << (row * 3 + col) % 9 + 1;
+      cv::Point p(col * SUDOKU_CELL_WORKING_SIZE + 5, row * SUDOKU_CELL_WORKING_SIZE + SUDOKU_CELL_WORKING_SIZE - 5);
+      cv::putText(solution, ss.str(), p, CV_FONT_HERSHEY_PLAIN, 2.2, cv::Scalar(0, 255, 0));
+    }
+  }
+
+  cv::cvtColor(solution, mask, CV_BGR2GRAY);
+  cv::threshold(mask, mask, 100, 255, CV_THRESH_BINARY);
+}
+
+// warping only the bounding box of the grid has to give the pixels of warping
+// the solution to the whole frame
+static void testOverlay(const cv::Mat& solution, const cv::Mat& mask, const Contour<float>& corners)
+{
+  float size = solution.cols;
+  Contour<float> rectified;
+  rectified.push_back(cv::Point2f(0, 0));
+  rectified.push_back(cv::Point2f(size, 0));
+  rectified.push_back(cv::Point2f(size, size));
+  rectified.push_back(cv::Point2f(0, size));
+  cv::Mat homography = cv::findHomography(corners, rectified, 0);
+
+  cv::Mat background(OVERLAY_TEST_FRAME_HEIGHT, OVERLAY_TEST_FRAME_WIDTH, CV_8UC3, cv::Scalar::all(128));
+  cv::Mat frame = background.clone();
+  SudokuFinder::overlaySolution(solution, mask, homography, corners, frame);
+
+  cv::Mat reference = background.clone();
+  cv::Mat warped, warpedMask;
+  cv::warpPerspective(solution, warped, homography, reference.size(), cv::WARP_INVERSE_MAP | cv::INTER_LINEAR);
+  cv::warpPerspective(mask, warpedMask, homography, reference.size(), cv::WARP_INVERSE_MAP | cv::INTER_NEAREST);
+  warped.copyTo(reference, warpedMask);
+
+  cv::Mat difference;
+  cv::absdiff(frame, reference, difference);
+  cv::cvtColor(difference, difference, CV_BGR2GRAY);
+  TEST_CHECK(cv::countNonZero(warpedMask) > 0);
+  TEST_CHECK(cv::countNonZero(difference) == 0);
+}
+
+int main()
+{
+  cv::Mat solution, mask;
+  renderSolution(solution, mask);
+
+  // a grid inside the frame and one cut off by its top left corner
+  Contour<float> inside, cutOff;
+  inside.push_back(cv::Point2f(112, 63));
+  inside.push_back(cv::Point2f(498, 81));
+  inside.push_back(cv::Point2f(530, 430));
+  inside.push_back(cv::Point2f(90, 401));
+  cutOff.push_back(cv::Point2f(-60, 40));
+  cutOff.push_back(cv::Point2f(400, -30));
+  cutOff.push_back(cv::Point2f(420, 380));
+  cutOff.push_back(cv::Point2f(-20, 300));
+
+  testOverlay(solution, mask, inside);
+  testOverlay(solution, mask, cutOff);
+
+  return testFailures;
+}
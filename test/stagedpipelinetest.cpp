@@ -0,0 +1,82 @@
+#include "../include/capture/memoryframesource.hpp"
+#include "../include/pipeline/stagedpipeline.hpp"
+#include "../include/pipeline/sudokupipeline.hpp"
+#include "testutils.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#define STAGED_TEST_FRAMES 30
+#define STAGED_TEST_STOP_AFTER 5
+
+// frames of a memory source are not live, so every one of them has to pass
+// all stages once and in order
+static void testLossless(const std::vector<cv::Mat>& frames)
+{
+  SudokuPipeline pipeline;
+  MemoryFrameSource source(frames);
+  StagedPipeline staged(pipeline, source);
+
+  std::vector<size_t> sequences;
+  bool framesComplete = true;
+  staged.start([&](const PipelineFrame& frame)
+  {
+    sequences.push_back(frame.sequence);
+    framesComplete = framesComplete && ! frame.frame.empty() && frame.finder;
+  });
+  staged.wait();
+
+  TEST_CHECK(! staged.isRunning());
+  TEST_CHECK(staged.capturedFrames() == frames.size());
+  TEST_CHECK(staged.renderedFrames() == frames.size());
+  TEST_CHECK(staged.droppedFrames() == 0);
+  TEST_CHECK(framesComplete);
+  TEST_CHECK(sequences.size() == frames.size());
+  for (size_t i = 0; i < sequences.size(); ++i)
+    TEST_CHECK(sequences[i] == i);
+}
+
+// stopping from the callback ends all stages, and a stopped pipeline starts again
+static void testStop(const std::vector<cv::Mat>& frames)
+{
+  SudokuPipeline pipeline;
+  MemoryFrameSource source(frames);
+  StagedPipeline staged(pipeline, source);
+
+  size_t rendered = 0;
+  staged.start([&](const PipelineFrame&)
+  {
+    if (++rendered == STAGED_TEST_STOP_AFTER)
+      staged.stop();
+  });
+  staged.wait();
+
+  TEST_CHECK(! staged.isRunning());
+  TEST_CHECK(rendered >= STAGED_TEST_STOP_AFTER);
+  TEST_CHECK(staged.renderedFrames() <= staged.capturedFrames());
+
+  source.rewind();
+  rendered = 0;
+  staged.start([&](const PipelineFrame&) { ++rendered; });
+  staged.wait();
+  TEST_CHECK(rendered == frames.size());
+}
+
+int main()
+{
+  // frames without a grid, each with a different gradient
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i < STAGED_TEST_FRAMES; ++i)
+  {
+    cv::Mat frame(240, 320, CV_8UC3);
+    for (int row = 0; row < frame.rows; ++row)
+      frame.row(row).setTo(cv::Scalar::all((row + i) % 256));
+    frames.push_back(frame);
+  }
+
+  testLossless(frames);
+  testStop(frames);
+
+  return testFailures;
+}
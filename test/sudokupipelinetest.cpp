@@ -0,0 +1,100 @@
+#include "../include/classification/trainingset.hpp"
+#include "../include/pipeline/sudokupipeline.hpp"
+#include "../include/settings.hpp"
+#include "testutils.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstring>
+#include <vector>
+
+#define PIPELINE_TEST_FRAMES (2 * NUM_FRAMES_FIXED)
+#define PIPELINE_TEST_GRID_X 140
+#define PIPELINE_TEST_GRID_Y 60
+
+// a valid sudoku pattern with every third cell left empty, the digits are
+// training images pasted into a drawn grid
+static cv::Mat gridFrame(const std::vector<cv::Mat> images[NUM_DIGITS])
+{
+  size_t cellSize = SUDOKU_CELL_WORKING_SIZE;
+  size_t gridSize = NUM_ROWS_CELLS * cellSize;
+  cv::Mat frame(480, 640, CV_8UC3, cv::Scalar::all(255));
+  cv::Mat grid = frame(cv::Rect(PIPELINE_TEST_GRID_X, PIPELINE_TEST_GRID_Y, gridSize, gridSize));
+
+  for (size_t row = 0; row < NUM_ROWS_CELLS; ++row)
+  {
+    for (size_t col = 0; col < NUM_ROWS_CELLS; ++col)
+    {
+      if ((row + col) % 3 == 0)
+        continue;
+
+      size_t digit = (row * 3 + row / 3 + col) % NUM_DIGITS + 1;
+      const std::vector<cv::Mat>& samples = images[digit - 1];
+      cv::Mat cell = grid(cv::Rect(col * cellSize, row * cellSize, cellSize, cellSize));
+      cv::resize(samples[(row * NUM_ROWS_CELLS + col) % samples.size()], cell, cell.size());
+    }
+  }
+
+  for (size_t i = 0; i <= NUM_ROWS_CELLS; ++i)
+  {
+    int thickness = i % 3 == 0 ? 3 : 1;
+    int offset = i * cellSize;
+    cv::line(grid, cv::Point(offset, 0), cv::Point(offset, gridSize), cv::Scalar::all(0), thickness);
+    cv::line(grid, cv::Point(0, offset), cv::Point(gridSize, offset), cv::Scalar::all(0), thickness);
+  }
+
+  return frame;
+}
+
+// shows the frame until all digits are fixed, returns whether they were
+static bool locks(SudokuPipeline& pipeline, const cv::Mat& frame, PipelineResult& result)
+{
+  for (size_t i = 0; i < PIPELINE_TEST_FRAMES; ++i)
+  {
+    pipeline.process(frame, result);
+    if (result.allFixed)
+      return true;
+  }
+
+  return false;
+}
+
+// a grid shown, taken away and shown again has to be fixed again, even
+// though its cells look as before and hit the classification cache
+int main()
+{
+  std::vector<cv::Mat> images[NUM_DIGITS];
+  TEST_CHECK(TrainingSet::load(TRAINING_DATA_DIR, images));
+  for (size_t digit = 0; digit < NUM_DIGITS; ++digit)
+  {
+    TEST_CHECK(! images[digit].empty());
+    if (images[digit].empty())
+      return testFailures;
+  }
+
+  SudokuPipeline pipeline;
+  pipeline.train(images);
+  TEST_CHECK(pipeline.hasClassifier());
+
+  cv::Mat grid = gridFrame(images);
+  cv::Mat blank(grid.rows, grid.cols, grid.type(), cv::Scalar::all(255));
+
+  PipelineResult first;
+  TEST_CHECK(locks(pipeline, grid, first));
+
+  bool disappeared = false;
+  for (size_t i = 0; i < NUM_FRAMES_LOST; ++i)
+  {
+    PipelineResult result;
+    pipeline.process(blank, result);
+    disappeared = disappeared || result.disappeared;
+  }
+  TEST_CHECK(disappeared);
+
+  PipelineResult second;
+  TEST_CHECK(locks(pipeline, grid, second));
+  TEST_CHECK(std::memcmp(first.digits, second.digits, sizeof(first.digits)) == 0);
+
+  return testFailures;
+}
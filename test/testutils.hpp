@@ -0,0 +1,33 @@
+#ifndef TESTUTILS_HPP__
+#define TESTUTILS_HPP__
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+// failed checks of the test executable, main returns their number
+static int testFailures = 0;
+
+#define TEST_CHECK(condition)                                                             \
+  do                                                                                      \
+  {                                                                                       \
+    if (! (condition))                                                                    \
+    {                                                                                     \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+      ++testFailures;                                                                     \
+    }                                                                                     \
+  }                                                                                       \
+  while (false)
+
+// a file name in the temporary directory unique to this process
+inline std::string temporaryFilename(const std::string& name)
+{
+  std::stringstream filename;
+  filename << P_tmpdir << "/vsudoku-test-" << getpid() << "-" << name;
+  return filename.str();
+}
+
+#endif // TESTUTILS_HPP